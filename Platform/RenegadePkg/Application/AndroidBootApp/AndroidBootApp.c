@@ -0,0 +1,467 @@
+// AndroidBootApp.c: Boots the Linux kernel in the Android boot image of the
+// active slot, straight from the raw partition.
+//
+// The whole image is read with one request, the kernel is started through
+// its EFI stub and picks up the ramdisk through the LoadFile2 initrd
+// protocol. Nothing is mounted and no other loader is involved.
+
+#include <Uefi.h>
+
+#include <Guid/Fdt.h>
+#include <Guid/LinuxEfiInitrdMedia.h>
+#include <IndustryStandard/PeImage.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/LoadedImage.h>
+#include <Protocol/LoadFile2.h>
+#include <Protocol/PartitionInfo.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Library/UefiBootManagerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include "AndroidBootImg.h"
+
+// A/B attributes of the boot partitions, as BootSlotLib keeps them
+#define PART_ATT_PRIORITY_BIT   48
+#define PART_ATT_ACTIVE_BIT     50
+#define PART_ATT_SUCCESS_BIT    54
+#define PART_ATT_UNBOOTABLE_BIT 55
+#define PART_ATT_PRIORITY_VAL   ((UINT64)0x3 << PART_ATT_PRIORITY_BIT)
+#define PART_ATT_ACTIVE_VAL     ((UINT64)0x1 << PART_ATT_ACTIVE_BIT)
+#define PART_ATT_SUCCESS_VAL    ((UINT64)0x1 << PART_ATT_SUCCESS_BIT)
+#define PART_ATT_UNBOOTABLE_VAL ((UINT64)0x1 << PART_ATT_UNBOOTABLE_BIT)
+
+#define FDT_MAGIC_BE 0xedfe0dd0
+
+#pragma pack(1)
+typedef struct {
+  VENDOR_DEVICE_PATH       VenMedia;
+  EFI_DEVICE_PATH_PROTOCOL End;
+} INITRD_DEVICE_PATH;
+#pragma pack()
+
+STATIC CONST INITRD_DEVICE_PATH mInitrdDevicePath = {
+    {{MEDIA_DEVICE_PATH,
+      MEDIA_VENDOR_DP,
+      {sizeof(VENDOR_DEVICE_PATH), 0}},
+     LINUX_EFI_INITRD_MEDIA_GUID},
+    {END_DEVICE_PATH_TYPE,
+     END_ENTIRE_DEVICE_PATH_SUBTYPE,
+     {sizeof(EFI_DEVICE_PATH_PROTOCOL), 0}}};
+
+STATIC CONST CHAR16 *mSlotSuffixes[] = {L"_a", L"_b"};
+
+STATIC VOID *mInitrd;
+STATIC UINTN mInitrdSize;
+
+STATIC
+EFI_STATUS
+EFIAPI
+InitrdLoadFile2(
+    IN EFI_LOAD_FILE2_PROTOCOL *This, IN EFI_DEVICE_PATH_PROTOCOL *FilePath,
+    IN BOOLEAN BootPolicy, IN OUT UINTN *BufferSize, IN VOID *Buffer OPTIONAL)
+{
+  if (BootPolicy)
+    return EFI_UNSUPPORTED;
+
+  if (BufferSize == NULL || !IsDevicePathValid(FilePath, 0))
+    return EFI_INVALID_PARAMETER;
+
+  if (FilePath->Type != END_DEVICE_PATH_TYPE ||
+      FilePath->SubType != END_ENTIRE_DEVICE_PATH_SUBTYPE)
+    return EFI_NOT_FOUND;
+
+  if (Buffer == NULL || *BufferSize < mInitrdSize) {
+    *BufferSize = mInitrdSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem(Buffer, mInitrd, mInitrdSize);
+  *BufferSize = mInitrdSize;
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_LOAD_FILE2_PROTOCOL mInitrdLoadFile2 = {InitrdLoadFile2};
+
+/**
+  Find the boot partition to load from: boot_a or boot_b on A/B devices,
+  picked the way BootSlotLib does, otherwise boot.
+
+  @param[out] Handle  Handle of the partition.
+  @param[out] Suffix  Slot suffix, empty without A/B slots.
+**/
+STATIC
+EFI_STATUS
+FindBootPartition(OUT EFI_HANDLE *Handle, OUT CONST CHAR16 **Suffix)
+{
+  EFI_PARTITION_INFO_PROTOCOL *Info;
+  EFI_HANDLE                  *Handles;
+  EFI_HANDLE                   Slots[2] = {NULL, NULL};
+  EFI_HANDLE                   Plain    = NULL;
+  UINT64                       Attributes[2];
+  UINT64                       Priority;
+  UINTN                        Best;
+  UINTN                        HandleCount;
+  UINTN                        Index;
+  UINTN                        Slot;
+  CHAR16                       Name[sizeof("boot_a")];
+  EFI_STATUS                   Status;
+
+  Status = gBS->LocateHandleBuffer(
+      ByProtocol, &gEfiPartitionInfoProtocolGuid, NULL, &HandleCount,
+      &Handles);
+  if (EFI_ERROR(Status))
+    return Status;
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol(
+        Handles[Index], &gEfiPartitionInfoProtocolGuid, (VOID **)&Info);
+    if (EFI_ERROR(Status) || Info->Type != PARTITION_TYPE_GPT)
+      continue;
+
+    if (Plain == NULL && StrCmp(Info->Info.Gpt.PartitionName, L"boot") == 0)
+      Plain = Handles[Index];
+
+    for (Slot = 0; Slot < ARRAY_SIZE(Slots); Slot++) {
+      UnicodeSPrint(Name, sizeof(Name), L"boot%s", mSlotSuffixes[Slot]);
+      if (Slots[Slot] == NULL &&
+          StrCmp(Info->Info.Gpt.PartitionName, Name) == 0) {
+        Slots[Slot]      = Handles[Index];
+        Attributes[Slot] = Info->Info.Gpt.Attributes;
+      }
+    }
+  }
+
+  FreePool(Handles);
+
+  if (Slots[0] == NULL || Slots[1] == NULL) {
+    if (Plain == NULL)
+      return EFI_NOT_FOUND;
+
+    *Handle = Plain;
+    *Suffix = L"";
+    return EFI_SUCCESS;
+  }
+
+  // Active slot with the highest priority
+  Best     = ARRAY_SIZE(Slots);
+  Priority = 0;
+  for (Slot = 0; Slot < ARRAY_SIZE(Slots); Slot++) {
+    if ((Attributes[Slot] & PART_ATT_ACTIVE_VAL) != 0 &&
+        RShiftU64(Attributes[Slot] & PART_ATT_PRIORITY_VAL,
+                  PART_ATT_PRIORITY_BIT) > Priority) {
+      Best     = Slot;
+      Priority = RShiftU64(
+          Attributes[Slot] & PART_ATT_PRIORITY_VAL, PART_ATT_PRIORITY_BIT);
+    }
+  }
+
+  // Nothing set up yet on the first boot, that means slot a
+  if (Best == ARRAY_SIZE(Slots) &&
+      (Attributes[0] & (PART_ATT_PRIORITY_VAL | PART_ATT_ACTIVE_VAL |
+                        PART_ATT_SUCCESS_VAL | PART_ATT_UNBOOTABLE_VAL)) == 0)
+    Best = 0;
+
+  if (Best == ARRAY_SIZE(Slots))
+    return EFI_NOT_FOUND;
+
+  *Handle = Slots[Best];
+  *Suffix = mSlotSuffixes[Best];
+  return EFI_SUCCESS;
+}
+
+/**
+  Connect the storage the boot partitions live on. The raw devices are
+  tried first, everything else only if that was not enough.
+**/
+STATIC
+EFI_STATUS
+ConnectBootPartition(OUT EFI_HANDLE *Handle, OUT CONST CHAR16 **Suffix)
+{
+  EFI_BLOCK_IO_PROTOCOL *BlockIo;
+  EFI_HANDLE            *Handles;
+  UINTN                  HandleCount;
+  UINTN                  Index;
+  EFI_STATUS             Status;
+
+  Status = FindBootPartition(Handle, Suffix);
+  if (!EFI_ERROR(Status))
+    return Status;
+
+  Status = gBS->LocateHandleBuffer(
+      ByProtocol, &gEfiBlockIoProtocolGuid, NULL, &HandleCount, &Handles);
+  if (!EFI_ERROR(Status)) {
+    for (Index = 0; Index < HandleCount; Index++) {
+      Status = gBS->HandleProtocol(
+          Handles[Index], &gEfiBlockIoProtocolGuid, (VOID **)&BlockIo);
+      if (!EFI_ERROR(Status) && !BlockIo->Media->LogicalPartition)
+        gBS->ConnectController(Handles[Index], NULL, NULL, TRUE);
+    }
+    FreePool(Handles);
+
+    Status = FindBootPartition(Handle, Suffix);
+    if (!EFI_ERROR(Status))
+      return Status;
+  }
+
+  EfiBootManagerConnectAll();
+  return FindBootPartition(Handle, Suffix);
+}
+
+STATIC
+UINT64
+PageAlign(UINT64 Size, UINT32 PageSize)
+{
+  return (Size + PageSize - 1) & ~(UINT64)(PageSize - 1);
+}
+
+/**
+  Read the boot image, up to the end of its last section, into memory.
+
+  @param[out] Image      Pages holding the image, header first.
+  @param[out] ImagePages Size of the allocation in pages.
+**/
+STATIC
+EFI_STATUS
+ReadBootImage(
+    IN EFI_HANDLE Partition, OUT BOOT_IMG_HDR **Image, OUT UINTN *ImagePages)
+{
+  EFI_BLOCK_IO_PROTOCOL *BlockIo;
+  BOOT_IMG_HDR          *Hdr;
+  EFI_STATUS             Status;
+  UINT64                 Size;
+  UINT64                 Start;
+  UINTN                  HdrPages;
+  UINTN                  Pages;
+  UINT32                 BlockSize;
+  VOID                  *Buffer;
+
+  Status = gBS->HandleProtocol(
+      Partition, &gEfiBlockIoProtocolGuid, (VOID **)&BlockIo);
+  if (EFI_ERROR(Status))
+    return Status;
+
+  BlockSize = BlockIo->Media->BlockSize;
+  HdrPages  = EFI_SIZE_TO_PAGES(ALIGN_VALUE(sizeof(BOOT_IMG_HDR), BlockSize));
+  Hdr       = AllocatePages(HdrPages);
+  if (Hdr == NULL)
+    return EFI_OUT_OF_RESOURCES;
+
+  Status = BlockIo->ReadBlocks(
+      BlockIo, BlockIo->Media->MediaId, 0,
+      ALIGN_VALUE(sizeof(BOOT_IMG_HDR), BlockSize), Hdr);
+  if (EFI_ERROR(Status))
+    goto exit;
+
+  if (CompareMem(Hdr->Magic, BOOT_MAGIC, BOOT_MAGIC_SIZE) != 0 ||
+      Hdr->HeaderVersion > BOOT_MAX_HEADER_VERSION || Hdr->PageSize < 2048 ||
+      (Hdr->PageSize & (Hdr->PageSize - 1)) != 0 || Hdr->KernelSize == 0) {
+    DEBUG((EFI_D_ERROR, "AndroidBootApp: no usable boot image\n"));
+    Status = EFI_NOT_FOUND;
+    goto exit;
+  }
+
+  Size = Hdr->PageSize + PageAlign(Hdr->KernelSize, Hdr->PageSize) +
+         PageAlign(Hdr->RamdiskSize, Hdr->PageSize) +
+         PageAlign(Hdr->SecondSize, Hdr->PageSize);
+  if (Hdr->HeaderVersion >= 1)
+    Size += PageAlign(Hdr->RecoveryDtboSize, Hdr->PageSize);
+  if (Hdr->HeaderVersion >= 2)
+    Size += PageAlign(Hdr->DtbSize, Hdr->PageSize);
+
+  Size = PageAlign(Size, BlockSize);
+  if (Size > MultU64x32(BlockIo->Media->LastBlock + 1, BlockSize)) {
+    Status = EFI_VOLUME_CORRUPTED;
+    goto exit;
+  }
+
+  Pages  = EFI_SIZE_TO_PAGES((UINTN)Size);
+  Buffer = AllocatePages(Pages);
+  if (Buffer == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto exit;
+  }
+
+  Start  = GetTimeInNanoSecond(GetPerformanceCounter());
+  Status = BlockIo->ReadBlocks(
+      BlockIo, BlockIo->Media->MediaId, 0, (UINTN)Size, Buffer);
+  if (EFI_ERROR(Status)) {
+    FreePages(Buffer, Pages);
+    goto exit;
+  }
+
+  DEBUG(
+      (EFI_D_INFO, "AndroidBootApp: read %lu KiB in %lu us\n",
+       RShiftU64(Size, 10),
+       DivU64x32(GetTimeInNanoSecond(GetPerformanceCounter()) - Start, 1000)));
+
+  *Image      = Buffer;
+  *ImagePages = Pages;
+
+exit:
+  FreePages(Hdr, HdrPages);
+  return Status;
+}
+
+/**
+  Kernel command line of the image as a load option, with the slot suffix
+  an Android bootloader would add.
+**/
+STATIC
+CHAR16 *
+GetCommandLine(IN BOOT_IMG_HDR *Hdr, IN CONST CHAR16 *Suffix)
+{
+  CHAR8  *Ascii;
+  CHAR16 *CommandLine;
+  UINTN   Length;
+  UINTN   ExtraLength;
+  UINTN   Size;
+
+  Length      = AsciiStrnLenS(Hdr->Cmdline, BOOT_ARGS_SIZE);
+  ExtraLength = AsciiStrnLenS(Hdr->ExtraCmdline, BOOT_EXTRA_ARGS_SIZE);
+  Size        = Length + ExtraLength + sizeof(" androidboot.slot_suffix=_a");
+
+  Ascii = AllocateZeroPool(Size);
+  if (Ascii == NULL)
+    return NULL;
+
+  // mkbootimg spills whatever does not fit into the extra field
+  CopyMem(Ascii, Hdr->Cmdline, Length);
+  CopyMem(Ascii + Length, Hdr->ExtraCmdline, ExtraLength);
+  if (*Suffix != L'\0')
+    AsciiSPrint(
+        Ascii + Length + ExtraLength, Size - Length - ExtraLength,
+        " androidboot.slot_suffix=%s", Suffix);
+
+  CommandLine = AllocatePool(AsciiStrSize(Ascii) * sizeof(CHAR16));
+  if (CommandLine != NULL)
+    AsciiStrToUnicodeStrS(Ascii, CommandLine, AsciiStrSize(Ascii));
+
+  FreePool(Ascii);
+  return CommandLine;
+}
+
+EFI_STATUS
+EFIAPI
+AndroidBootAppEntryPoint(
+    IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
+{
+  EFI_LOADED_IMAGE_PROTOCOL *LoadedImage;
+  EFI_IMAGE_DOS_HEADER      *DosHdr;
+  BOOT_IMG_HDR              *Image;
+  EFI_HANDLE                 Partition;
+  EFI_HANDLE                 KernelHandle;
+  EFI_HANDLE                 InitrdHandle;
+  CONST CHAR16              *Suffix;
+  CHAR16                    *CommandLine;
+  UINT8                     *Kernel;
+  VOID                      *Dtb;
+  VOID                      *OldDtb;
+  UINTN                      ImagePages;
+  UINTN                      Offset;
+  EFI_STATUS                 Status;
+
+  Status = ConnectBootPartition(&Partition, &Suffix);
+  if (EFI_ERROR(Status)) {
+    DEBUG((EFI_D_ERROR, "AndroidBootApp: no boot partition: %r\n", Status));
+    return Status;
+  }
+
+  Status = ReadBootImage(Partition, &Image, &ImagePages);
+  if (EFI_ERROR(Status))
+    return Status;
+
+  DEBUG(
+      (EFI_D_INFO, "AndroidBootApp: boot%s, header v%u\n", Suffix,
+       Image->HeaderVersion));
+
+  // Only kernels with an EFI stub can be started this way
+  Kernel = (UINT8 *)Image + Image->PageSize;
+  DosHdr = (EFI_IMAGE_DOS_HEADER *)Kernel;
+  if (DosHdr->e_magic != EFI_IMAGE_DOS_SIGNATURE) {
+    DEBUG((EFI_D_ERROR, "AndroidBootApp: kernel has no EFI stub\n"));
+    Status = EFI_UNSUPPORTED;
+    goto free_image;
+  }
+
+  Offset =
+      Image->PageSize + (UINTN)PageAlign(Image->KernelSize, Image->PageSize);
+  mInitrd     = (UINT8 *)Image + Offset;
+  mInitrdSize = Image->RamdiskSize;
+
+  // A device tree in the image replaces the one of the firmware
+  Dtb    = NULL;
+  OldDtb = NULL;
+  if (Image->HeaderVersion >= 2 && Image->DtbSize != 0) {
+    Offset += (UINTN)(PageAlign(Image->RamdiskSize, Image->PageSize) +
+                      PageAlign(Image->SecondSize, Image->PageSize) +
+                      PageAlign(Image->RecoveryDtboSize, Image->PageSize));
+    if (*(UINT32 *)((UINT8 *)Image + Offset) == FDT_MAGIC_BE)
+      Dtb = AllocateCopyPool(Image->DtbSize, (UINT8 *)Image + Offset);
+  }
+
+  if (Dtb != NULL) {
+    EfiGetSystemConfigurationTable(&gFdtTableGuid, &OldDtb);
+    gBS->InstallConfigurationTable(&gFdtTableGuid, Dtb);
+  }
+
+  InitrdHandle = NULL;
+  if (mInitrdSize != 0) {
+    Status = gBS->InstallMultipleProtocolInterfaces(
+        &InitrdHandle, &gEfiDevicePathProtocolGuid, &mInitrdDevicePath,
+        &gEfiLoadFile2ProtocolGuid, &mInitrdLoadFile2, NULL);
+    if (EFI_ERROR(Status))
+      goto free_dtb;
+  }
+
+  Status = gBS->LoadImage(
+      FALSE, ImageHandle, DevicePathFromHandle(Partition), Kernel,
+      Image->KernelSize, &KernelHandle);
+  if (EFI_ERROR(Status)) {
+    DEBUG((EFI_D_ERROR, "AndroidBootApp: LoadImage: %r\n", Status));
+    goto free_initrd;
+  }
+
+  Status = gBS->HandleProtocol(
+      KernelHandle, &gEfiLoadedImageProtocolGuid, (VOID **)&LoadedImage);
+  ASSERT_EFI_ERROR(Status);
+
+  CommandLine = GetCommandLine(Image, Suffix);
+  if (CommandLine != NULL) {
+    LoadedImage->LoadOptions     = CommandLine;
+    LoadedImage->LoadOptionsSize = (UINT32)StrSize(CommandLine);
+  }
+
+  Status = gBS->StartImage(KernelHandle, NULL, NULL);
+
+  // Only back here if the kernel gave up before ExitBootServices
+  DEBUG((EFI_D_ERROR, "AndroidBootApp: kernel returned: %r\n", Status));
+  gBS->UnloadImage(KernelHandle);
+  if (CommandLine != NULL)
+    FreePool(CommandLine);
+
+free_initrd:
+  if (InitrdHandle != NULL)
+    gBS->UninstallMultipleProtocolInterfaces(
+        InitrdHandle, &gEfiDevicePathProtocolGuid, &mInitrdDevicePath,
+        &gEfiLoadFile2ProtocolGuid, &mInitrdLoadFile2, NULL);
+
+free_dtb:
+  if (Dtb != NULL) {
+    gBS->InstallConfigurationTable(&gFdtTableGuid, OldDtb);
+    FreePool(Dtb);
+  }
+
+free_image:
+  FreePages(Image, ImagePages);
+  return Status;
+}
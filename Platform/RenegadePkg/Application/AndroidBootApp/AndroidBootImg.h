@@ -0,0 +1,42 @@
+// AndroidBootImg.h: Android boot image header, versions 0 to 2.
+
+#ifndef _ANDROID_BOOT_IMG_H_
+#define _ANDROID_BOOT_IMG_H_
+
+#define BOOT_MAGIC             "ANDROID!"
+#define BOOT_MAGIC_SIZE        8
+#define BOOT_NAME_SIZE         16
+#define BOOT_ARGS_SIZE         512
+#define BOOT_EXTRA_ARGS_SIZE   1024
+#define BOOT_MAX_HEADER_VERSION 2
+
+#pragma pack(1)
+typedef struct {
+  UINT8  Magic[BOOT_MAGIC_SIZE];
+  UINT32 KernelSize;
+  UINT32 KernelAddr;
+  UINT32 RamdiskSize;
+  UINT32 RamdiskAddr;
+  UINT32 SecondSize;
+  UINT32 SecondAddr;
+  UINT32 TagsAddr;
+  UINT32 PageSize;
+  UINT32 HeaderVersion;
+  UINT32 OsVersion;
+  CHAR8  Name[BOOT_NAME_SIZE];
+  CHAR8  Cmdline[BOOT_ARGS_SIZE];
+  UINT32 Id[8];
+  CHAR8  ExtraCmdline[BOOT_EXTRA_ARGS_SIZE];
+
+  // Version 1
+  UINT32 RecoveryDtboSize;
+  UINT64 RecoveryDtboOffset;
+  UINT32 HeaderSize;
+
+  // Version 2
+  UINT32 DtbSize;
+  UINT64 DtbAddr;
+} BOOT_IMG_HDR;
+#pragma pack()
+
+#endif /* _ANDROID_BOOT_IMG_H_ */
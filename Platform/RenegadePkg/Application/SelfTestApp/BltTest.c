@@ -0,0 +1,400 @@
+/** @file
+  FrameBufferBltLib checks against a per-pixel reference model on an
+  off-screen frame buffer, for both 32-bpp formats and with and without
+  scanline padding, followed by full screen throughput numbers.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Protocol/GraphicsOutput.h>
+#include <Library/FrameBufferBltLib.h>
+
+#include "SelfTestApp.h"
+
+// Small screens keep the reference model fast, odd sizes hit the tails
+#define BLT_TEST_HEIGHT 37
+#define BLT_TEST_STRIDE 64
+
+// Blt buffer the BufferToVideo and VideoToBltBuffer rectangles come from
+#define BLT_TEST_BUFFER_WIDTH  80
+#define BLT_TEST_BUFFER_HEIGHT 50
+
+#define BLT_TEST_SCREEN_BYTES \
+  (BLT_TEST_STRIDE * BLT_TEST_HEIGHT * sizeof(UINT32))
+#define BLT_TEST_BUFFER_BYTES \
+  (BLT_TEST_BUFFER_WIDTH * BLT_TEST_BUFFER_HEIGHT * sizeof(UINT32))
+
+#define BLT_TEST_ROUNDS 3000
+
+// The reserved byte carries nothing for scanout, either value is right
+#define BLT_TEST_COLOR_MASK 0x00FFFFFF
+
+// Screen the benchmark draws on, as large as the biggest panel
+#define BLT_BENCH_WIDTH  1440
+#define BLT_BENCH_HEIGHT 3200
+#define BLT_BENCH_ROUNDS 32
+
+typedef struct {
+  EFI_GRAPHICS_PIXEL_FORMAT Format;
+  UINT32                    Width;
+  CONST CHAR8              *Name;
+} BLT_TEST_MODE;
+
+STATIC CONST BLT_TEST_MODE mModes[] = {
+    {PixelBlueGreenRedReserved8BitPerColor, BLT_TEST_STRIDE - 3, "BGR"},
+    {PixelBlueGreenRedReserved8BitPerColor, BLT_TEST_STRIDE, "BGR unpadded"},
+    {PixelRedGreenBlueReserved8BitPerColor, BLT_TEST_STRIDE - 3, "RGB"},
+    {PixelRedGreenBlueReserved8BitPerColor, BLT_TEST_STRIDE, "RGB unpadded"},
+};
+
+STATIC UINT32 mSeed;
+
+STATIC UINT32 NextRandom(VOID)
+{
+  mSeed = mSeed * 1103515245 + 12345;
+  return (mSeed >> 8) ^ (mSeed << 20);
+}
+
+STATIC UINTN RandomBelow(UINTN Limit) { return NextRandom() % Limit; }
+
+STATIC VOID FillRandom(UINT32 *Buffer, UINTN Count)
+{
+  for (UINTN Index = 0; Index < Count; Index++)
+    Buffer[Index] = NextRandom();
+}
+
+STATIC UINT32 ToScreen(UINT32 Pixel, BOOLEAN Swap)
+{
+  if (!Swap)
+    return Pixel;
+
+  return (Pixel & 0xFF00FF00) | ((Pixel >> 16) & 0xFF) | ((Pixel & 0xFF) << 16);
+}
+
+STATIC BOOLEAN SamePixels(CONST UINT32 *Left, CONST UINT32 *Right, UINTN Count)
+{
+  for (UINTN Index = 0; Index < Count; Index++) {
+    if (((Left[Index] ^ Right[Index]) & BLT_TEST_COLOR_MASK) != 0)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*
+ * One random operation on both the library and the model. Returns FALSE
+ * if the library refused a valid request.
+ */
+STATIC BOOLEAN RandomBlt(
+    FRAME_BUFFER_CONFIGURE *Configure, UINT32 Width, BOOLEAN Swap,
+    UINT32 *Model, UINT32 *Buffer, UINT32 *BufferModel,
+    CONST CHAR8 **Operation)
+{
+  EFI_GRAPHICS_OUTPUT_BLT_OPERATION BltOperation;
+  UINTN                             SourceX;
+  UINTN                             SourceY;
+  UINTN                             DestX;
+  UINTN                             DestY;
+  UINTN                             RectWidth;
+  UINTN                             RectHeight;
+  UINTN                             Delta;
+  UINTN                             Pitch;
+  UINT32                            Rect[BLT_TEST_STRIDE * BLT_TEST_HEIGHT];
+
+  // Full width and height now and then, to reach the contiguous paths
+  RectWidth  = RandomBelow(4) == 0 ? Width : 1 + RandomBelow(Width);
+  RectHeight = RandomBelow(4) == 0 ? BLT_TEST_HEIGHT
+                                   : 1 + RandomBelow(BLT_TEST_HEIGHT);
+  DestX      = RandomBelow(Width - RectWidth + 1);
+  DestY      = RandomBelow(BLT_TEST_HEIGHT - RectHeight + 1);
+  SourceX    = RandomBelow(Width - RectWidth + 1);
+  SourceY    = RandomBelow(BLT_TEST_HEIGHT - RectHeight + 1);
+
+  // A zero Delta means rows of RectWidth pixels
+  Delta = RandomBelow(3) == 0 ? 0 : BLT_TEST_BUFFER_WIDTH * sizeof(UINT32);
+  Pitch = Delta == 0 ? RectWidth : BLT_TEST_BUFFER_WIDTH;
+
+  BltOperation = (EFI_GRAPHICS_OUTPUT_BLT_OPERATION)RandomBelow(4);
+  switch (BltOperation) {
+  case EfiBltVideoFill:
+    *Operation     = "VideoFill";
+    Buffer[0]      = NextRandom();
+    BufferModel[0] = Buffer[0];
+    for (UINTN Y = 0; Y < RectHeight; Y++) {
+      for (UINTN X = 0; X < RectWidth; X++)
+        Model[(DestY + Y) * BLT_TEST_STRIDE + DestX + X] =
+            ToScreen(Buffer[0], Swap);
+    }
+    break;
+
+  case EfiBltVideoToBltBuffer:
+    *Operation = "VideoToBltBuffer";
+    DestX      = RandomBelow(BLT_TEST_BUFFER_WIDTH - RectWidth + 1);
+    DestY      = RandomBelow(BLT_TEST_BUFFER_HEIGHT - RectHeight + 1);
+    for (UINTN Y = 0; Y < RectHeight; Y++) {
+      for (UINTN X = 0; X < RectWidth; X++)
+        BufferModel[(DestY + Y) * Pitch + DestX + X] = ToScreen(
+            Model[(SourceY + Y) * BLT_TEST_STRIDE + SourceX + X], Swap);
+    }
+    break;
+
+  case EfiBltBufferToVideo:
+    *Operation = "BufferToVideo";
+    SourceX    = RandomBelow(BLT_TEST_BUFFER_WIDTH - RectWidth + 1);
+    SourceY    = RandomBelow(BLT_TEST_BUFFER_HEIGHT - RectHeight + 1);
+    for (UINTN Y = 0; Y < RectHeight; Y++) {
+      for (UINTN X = 0; X < RectWidth; X++)
+        Model[(DestY + Y) * BLT_TEST_STRIDE + DestX + X] = ToScreen(
+            BufferModel[(SourceY + Y) * Pitch + SourceX + X], Swap);
+    }
+    break;
+
+  default:
+    *Operation = "VideoToVideo";
+    for (UINTN Y = 0; Y < RectHeight; Y++) {
+      for (UINTN X = 0; X < RectWidth; X++)
+        Rect[Y * RectWidth + X] =
+            Model[(SourceY + Y) * BLT_TEST_STRIDE + SourceX + X];
+    }
+    for (UINTN Y = 0; Y < RectHeight; Y++) {
+      for (UINTN X = 0; X < RectWidth; X++)
+        Model[(DestY + Y) * BLT_TEST_STRIDE + DestX + X] =
+            Rect[Y * RectWidth + X];
+    }
+    break;
+  }
+
+  return !RETURN_ERROR(FrameBufferBlt(
+      Configure, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)Buffer, BltOperation,
+      SourceX, SourceY, DestX, DestY, RectWidth, RectHeight, Delta));
+}
+
+STATIC UINTN CheckMode(
+    CONST BLT_TEST_MODE *Mode, UINT32 *Screen, UINT32 *Model, UINT32 *Buffer,
+    UINT32 *BufferModel)
+{
+  EFI_GRAPHICS_OUTPUT_MODE_INFORMATION Info;
+  FRAME_BUFFER_CONFIGURE              *Configure = NULL;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL        Pixel;
+  UINTN                                ConfigureSize = 0;
+  UINTN                                ScreenCount;
+  UINTN                                BufferCount;
+  UINTN                                Failures = 0;
+  CONST CHAR8                         *Operation;
+  BOOLEAN                              Swap;
+
+  ZeroMem(&Info, sizeof(Info));
+  Info.HorizontalResolution = Mode->Width;
+  Info.VerticalResolution   = BLT_TEST_HEIGHT;
+  Info.PixelFormat          = Mode->Format;
+  Info.PixelsPerScanLine    = BLT_TEST_STRIDE;
+
+  ScreenCount = BLT_TEST_STRIDE * BLT_TEST_HEIGHT;
+  BufferCount = BLT_TEST_BUFFER_WIDTH * BLT_TEST_BUFFER_HEIGHT;
+  Swap        = Mode->Format == PixelRedGreenBlueReserved8BitPerColor;
+
+  if (FrameBufferBltConfigure(Screen, &Info, NULL, &ConfigureSize) !=
+      RETURN_BUFFER_TOO_SMALL)
+    ConfigureSize = 0;
+  if (ConfigureSize != 0)
+    Configure = AllocatePool(ConfigureSize);
+  if (SelfTestCheck(
+          &Failures,
+          Configure != NULL && !RETURN_ERROR(FrameBufferBltConfigure(
+                                   Screen, &Info, Configure, &ConfigureSize)),
+          L"  %a: configure failed\n", Mode->Name))
+    goto exit;
+
+  FillRandom(Screen, ScreenCount);
+  FillRandom(Buffer, BufferCount);
+  CopyMem(Model, Screen, BLT_TEST_SCREEN_BYTES);
+  CopyMem(BufferModel, Buffer, BLT_TEST_BUFFER_BYTES);
+
+  for (UINTN Round = 0; Round < BLT_TEST_ROUNDS; Round++) {
+    if (SelfTestCheck(
+            &Failures,
+            RandomBlt(
+                Configure, Mode->Width, Swap, Model, Buffer, BufferModel,
+                &Operation),
+            L"  %a: round %u refused\n", Mode->Name, (UINT32)Round))
+      goto exit;
+
+    // Padding past the visible width has to stay as it was
+    if (SelfTestCheck(
+            &Failures,
+            SamePixels(Screen, Model, ScreenCount) &&
+                SamePixels(Buffer, BufferModel, BufferCount),
+            L"  %a: %a differs in round %u\n", Mode->Name, Operation,
+            (UINT32)Round))
+      goto exit;
+  }
+
+  // Out of bounds and empty rectangles are refused and change nothing
+  SetMem(&Pixel, sizeof(Pixel), 0x5A);
+  SelfTestCheck(
+      &Failures,
+      FrameBufferBlt(
+          Configure, &Pixel, EfiBltVideoFill, 0, 0, 1, 0, Mode->Width, 1, 0) ==
+              RETURN_INVALID_PARAMETER &&
+          FrameBufferBlt(
+              Configure, NULL, EfiBltVideoToVideo, 0, 1, 0, 0, 1,
+              BLT_TEST_HEIGHT, 0) == RETURN_INVALID_PARAMETER &&
+          FrameBufferBlt(
+              Configure, &Pixel, EfiBltVideoFill, 0, 0, 0, 0, 0, 1, 0) ==
+              RETURN_INVALID_PARAMETER &&
+          SamePixels(Screen, Model, ScreenCount),
+      L"  %a: invalid rectangle accepted\n", Mode->Name);
+
+exit:
+  if (Configure != NULL)
+    FreePool(Configure);
+
+  return Failures;
+}
+
+STATIC UINTN CheckBitMask(UINT32 *Screen)
+{
+  EFI_GRAPHICS_OUTPUT_MODE_INFORMATION Info;
+  UINTN                                ConfigureSize = 0;
+  UINTN                                Failures      = 0;
+
+  ZeroMem(&Info, sizeof(Info));
+  Info.HorizontalResolution = BLT_TEST_STRIDE;
+  Info.VerticalResolution   = BLT_TEST_HEIGHT;
+  Info.PixelFormat          = PixelBitMask;
+  Info.PixelsPerScanLine    = BLT_TEST_STRIDE;
+
+  SelfTestCheck(
+      &Failures,
+      FrameBufferBltConfigure(Screen, &Info, NULL, &ConfigureSize) ==
+          RETURN_UNSUPPORTED,
+      L"  PixelBitMask accepted\n");
+
+  return Failures;
+}
+
+STATIC VOID Benchmark(
+    EFI_GRAPHICS_PIXEL_FORMAT Format, CONST CHAR16 *Name, UINT32 *Screen,
+    UINT32 *Buffer)
+{
+  EFI_GRAPHICS_OUTPUT_MODE_INFORMATION Info;
+  FRAME_BUFFER_CONFIGURE              *Configure;
+  UINTN                                ConfigureSize = 0;
+  UINTN                                Size;
+  UINT64                               Start;
+
+  ZeroMem(&Info, sizeof(Info));
+  Info.HorizontalResolution = BLT_BENCH_WIDTH;
+  Info.VerticalResolution   = BLT_BENCH_HEIGHT;
+  Info.PixelFormat          = Format;
+  Info.PixelsPerScanLine    = BLT_BENCH_WIDTH;
+
+  FrameBufferBltConfigure(Screen, &Info, NULL, &ConfigureSize);
+  Configure = AllocatePool(ConfigureSize);
+  if (Configure == NULL ||
+      RETURN_ERROR(
+          FrameBufferBltConfigure(Screen, &Info, Configure, &ConfigureSize))) {
+    Print(L"  %s: configure failed\n", Name);
+    goto exit;
+  }
+
+  Size = BLT_BENCH_WIDTH * BLT_BENCH_HEIGHT * sizeof(UINT32);
+  Print(L"  %s, %ux%u:\n", Name, BLT_BENCH_WIDTH, BLT_BENCH_HEIGHT);
+
+  Start = GetPerformanceCounter();
+  for (UINTN Round = 0; Round < BLT_BENCH_ROUNDS; Round++)
+    FrameBufferBlt(
+        Configure, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)&Buffer[Round],
+        EfiBltVideoFill, 0, 0, 0, 0, BLT_BENCH_WIDTH, BLT_BENCH_HEIGHT, 0);
+  SelfTestReportRate(L"VideoFill", Size, Size * BLT_BENCH_ROUNDS, Start);
+
+  Start = GetPerformanceCounter();
+  for (UINTN Round = 0; Round < BLT_BENCH_ROUNDS; Round++)
+    FrameBufferBlt(
+        Configure, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)Buffer,
+        EfiBltBufferToVideo, 0, 0, 0, 0, BLT_BENCH_WIDTH, BLT_BENCH_HEIGHT,
+        0);
+  SelfTestReportRate(L"BufferToVideo", Size, Size * BLT_BENCH_ROUNDS, Start);
+
+  Start = GetPerformanceCounter();
+  for (UINTN Round = 0; Round < BLT_BENCH_ROUNDS; Round++)
+    FrameBufferBlt(
+        Configure, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)Buffer,
+        EfiBltVideoToBltBuffer, 0, 0, 0, 0, BLT_BENCH_WIDTH, BLT_BENCH_HEIGHT,
+        0);
+  SelfTestReportRate(L"VideoToBlt", Size, Size * BLT_BENCH_ROUNDS, Start);
+
+  // One console text line up, as GraphicsConsole scrolls
+  Start = GetPerformanceCounter();
+  for (UINTN Round = 0; Round < BLT_BENCH_ROUNDS; Round++)
+    FrameBufferBlt(
+        Configure, NULL, EfiBltVideoToVideo, 0, 19, 0, 0, BLT_BENCH_WIDTH,
+        BLT_BENCH_HEIGHT - 19, 0);
+  SelfTestReportRate(L"Scroll", Size, Size * BLT_BENCH_ROUNDS, Start);
+
+  // Partial width rows take the per-row path
+  Start = GetPerformanceCounter();
+  for (UINTN Round = 0; Round < BLT_BENCH_ROUNDS; Round++)
+    FrameBufferBlt(
+        Configure, NULL, EfiBltVideoToVideo, 1, 0, 0, 0, BLT_BENCH_WIDTH - 1,
+        BLT_BENCH_HEIGHT, 0);
+  SelfTestReportRate(L"ScrollLeft", Size, Size * BLT_BENCH_ROUNDS, Start);
+
+exit:
+  if (Configure != NULL)
+    FreePool(Configure);
+}
+
+UINTN BltTestRun(VOID)
+{
+  UINT32 *Screen;
+  UINT32 *Model;
+  UINT32 *Buffer;
+  UINT32 *BufferModel;
+  UINT32 *Bench;
+  UINTN   BenchPages;
+  UINTN   Failures = 0;
+
+  BenchPages  = EFI_SIZE_TO_PAGES(
+      2 * BLT_BENCH_WIDTH * BLT_BENCH_HEIGHT * sizeof(UINT32));
+  Screen      = AllocatePool(BLT_TEST_SCREEN_BYTES);
+  Model       = AllocatePool(BLT_TEST_SCREEN_BYTES);
+  Buffer      = AllocatePool(BLT_TEST_BUFFER_BYTES);
+  BufferModel = AllocatePool(BLT_TEST_BUFFER_BYTES);
+  Bench       = AllocatePages(BenchPages);
+
+  if (Screen == NULL || Model == NULL || Buffer == NULL ||
+      BufferModel == NULL || Bench == NULL) {
+    Print(L"  out of memory\n");
+    Failures = 1;
+    goto exit;
+  }
+
+  mSeed = 1;
+  for (UINTN Index = 0; Index < ARRAY_SIZE(mModes); Index++)
+    Failures += CheckMode(&mModes[Index], Screen, Model, Buffer, BufferModel);
+  Failures += CheckBitMask(Screen);
+
+  // Off-screen, so the numbers are the kernels and not the panel memory
+  FillRandom(Bench, 2 * BLT_BENCH_WIDTH * BLT_BENCH_HEIGHT);
+  Benchmark(
+      PixelBlueGreenRedReserved8BitPerColor, L"BGR", Bench,
+      Bench + BLT_BENCH_WIDTH * BLT_BENCH_HEIGHT);
+  Benchmark(
+      PixelRedGreenBlueReserved8BitPerColor, L"RGB", Bench,
+      Bench + BLT_BENCH_WIDTH * BLT_BENCH_HEIGHT);
+
+exit:
+  if (Screen != NULL)
+    FreePool(Screen);
+  if (Model != NULL)
+    FreePool(Model);
+  if (Buffer != NULL)
+    FreePool(Buffer);
+  if (BufferModel != NULL)
+    FreePool(BufferModel);
+  if (Bench != NULL)
+    FreePages(Bench, BenchPages);
+
+  return Failures;
+}
@@ -0,0 +1,278 @@
+/** @file
+  BaseMemoryLib checks against byte-at-a-time reference loops over every
+  source and destination alignment and the length boundaries of the
+  AArch64 routines, followed by throughput numbers next to those of the
+  same reference loops.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "SelfTestApp.h"
+
+// Untouched bytes around every operation, checked along with the result
+#define MEM_TEST_GUARD 80
+
+// Longest length checked, well past the cache line zeroing threshold
+#define MEM_TEST_MAX_LENGTH SIZE_4KB
+
+#define MEM_TEST_BUFFER_SIZE (MEM_TEST_MAX_LENGTH + 2 * MEM_TEST_GUARD)
+
+// From below the small copy path to well past the last level cache
+STATIC CONST UINTN mBenchSizes[] = {
+    16, 64, 256, SIZE_4KB, SIZE_64KB, SIZE_1MB, SIZE_8MB, SIZE_32MB};
+
+#define MEM_TEST_BENCH_MAX_SIZE SIZE_32MB
+
+// Data moved per benchmark, enough for a stable number at every size
+#define MEM_TEST_BENCH_BYTES SIZE_256MB
+
+// Less for the byte loops, which run an order of magnitude slower
+#define MEM_TEST_REF_BYTES SIZE_32MB
+
+/* Every length up to 300, then one below and at each power of two */
+STATIC UINTN NextLength(UINTN Length)
+{
+  if (Length < 300 || (Length & (Length + 1)) == 0)
+    Length++;
+  else
+    Length = (UINTN)GetPowerOfTwo64(Length) * 2 - 1;
+
+  return Length > MEM_TEST_MAX_LENGTH ? MAX_UINTN : Length;
+}
+
+STATIC BOOLEAN SameBytes(CONST UINT8 *Left, CONST UINT8 *Right, UINTN Length)
+{
+  for (UINTN Index = 0; Index < Length; Index++) {
+    if (Left[Index] != Right[Index])
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Copies from a separate buffer into every alignment */
+STATIC UINTN CheckCopy(UINT8 *Source, UINT8 *Actual, UINT8 *Expected)
+{
+  UINTN  Failures = 0;
+  UINT8 *From;
+
+  SelfTestFillPattern(Source, MEM_TEST_BUFFER_SIZE, 0x11);
+
+  for (UINTN Length = 0; Length != MAX_UINTN; Length = NextLength(Length)) {
+    for (UINTN SrcAlign = 0; SrcAlign < 16; SrcAlign++) {
+      for (UINTN DstAlign = 0; DstAlign < 16; DstAlign++) {
+        From = Source + MEM_TEST_GUARD + SrcAlign;
+        SelfTestFillPattern(Actual, MEM_TEST_BUFFER_SIZE, 0x5C);
+        SelfTestFillPattern(Expected, MEM_TEST_BUFFER_SIZE, 0x5C);
+
+        for (UINTN Index = 0; Index < Length; Index++)
+          Expected[MEM_TEST_GUARD + DstAlign + Index] = From[Index];
+        CopyMem(Actual + MEM_TEST_GUARD + DstAlign, From, Length);
+
+        if (SelfTestCheck(
+                &Failures, SameBytes(Actual, Expected, MEM_TEST_BUFFER_SIZE),
+                L"  CopyMem: length %u, alignment %u/%u\n", (UINT32)Length,
+                (UINT32)SrcAlign, (UINT32)DstAlign))
+          return Failures;
+      }
+    }
+  }
+
+  return Failures;
+}
+
+/* Overlapping moves in both directions */
+STATIC UINTN CheckMove(UINT8 *Actual, UINT8 *Expected)
+{
+  UINTN Failures = 0;
+  UINTN Source   = MEM_TEST_GUARD;
+  UINTN Dest;
+
+  for (UINTN Length = 0; Length != MAX_UINTN; Length = NextLength(Length)) {
+    for (INTN Shift = -MEM_TEST_GUARD + 1; Shift < MEM_TEST_GUARD; Shift++) {
+      Dest = Source + Shift;
+      SelfTestFillPattern(Actual, MEM_TEST_BUFFER_SIZE, (UINT8)Shift);
+      SelfTestFillPattern(Expected, MEM_TEST_BUFFER_SIZE, (UINT8)Shift);
+
+      // Moving up has to start at the far end not to read what it wrote
+      if (Dest > Source) {
+        for (UINTN Index = Length; Index > 0; Index--)
+          Expected[Dest + Index - 1] = Expected[Source + Index - 1];
+      } else {
+        for (UINTN Index = 0; Index < Length; Index++)
+          Expected[Dest + Index] = Expected[Source + Index];
+      }
+      CopyMem(Actual + Dest, Actual + Source, Length);
+
+      if (SelfTestCheck(
+              &Failures, SameBytes(Actual, Expected, MEM_TEST_BUFFER_SIZE),
+              L"  CopyMem: overlapping length %u, shift %d\n", (UINT32)Length,
+              (INT32)Shift))
+        return Failures;
+    }
+  }
+
+  return Failures;
+}
+
+/* SetMem with a non-zero value and ZeroMem over every alignment */
+STATIC UINTN CheckFill(UINT8 *Actual, UINT8 *Expected)
+{
+  UINTN Failures = 0;
+  UINT8 Value;
+
+  for (UINTN Length = 0; Length != MAX_UINTN; Length = NextLength(Length)) {
+    for (UINTN Align = 0; Align < 64; Align++) {
+      for (Value = 0; Value < 2; Value++) {
+        SelfTestFillPattern(Actual, MEM_TEST_BUFFER_SIZE, (UINT8)Align);
+        SelfTestFillPattern(Expected, MEM_TEST_BUFFER_SIZE, (UINT8)Align);
+
+        for (UINTN Index = 0; Index < Length; Index++)
+          Expected[MEM_TEST_GUARD + Align + Index] = Value * 0xC3;
+
+        if (Value == 0)
+          ZeroMem(Actual + MEM_TEST_GUARD + Align, Length);
+        else
+          SetMem(Actual + MEM_TEST_GUARD + Align, Length, 0xC3);
+
+        if (SelfTestCheck(
+                &Failures, SameBytes(Actual, Expected, MEM_TEST_BUFFER_SIZE),
+                L"  %a: length %u, alignment %u\n",
+                Value == 0 ? "ZeroMem" : "SetMem", (UINT32)Length,
+                (UINT32)Align))
+          return Failures;
+      }
+    }
+  }
+
+  return Failures;
+}
+
+/* CompareMem has to name the first differing byte with the right sign */
+STATIC UINTN CheckCompare(UINT8 *Left, UINT8 *Right)
+{
+  UINTN Failures = 0;
+  INTN  Result;
+
+  SelfTestFillPattern(Left, MEM_TEST_BUFFER_SIZE, 0x33);
+  SelfTestFillPattern(Right, MEM_TEST_BUFFER_SIZE, 0x33);
+
+  for (UINTN Length = 1; Length != MAX_UINTN; Length = NextLength(Length)) {
+    for (UINTN Diff = 0; Diff < Length; Diff += 1 + Diff / 8) {
+      Right[Diff] = Left[Diff] + 1;
+      Result      = CompareMem(Left, Right, Length);
+      Right[Diff] = Left[Diff];
+
+      // Left is the smaller one, except where the increment wrapped
+      if (SelfTestCheck(
+              &Failures, Result != 0 && (Result < 0) == (Left[Diff] != 0xFF),
+              L"  CompareMem: length %u, difference at %u\n", (UINT32)Length,
+              (UINT32)Diff))
+        return Failures;
+    }
+
+    if (SelfTestCheck(
+            &Failures, CompareMem(Left, Right, Length) == 0,
+            L"  CompareMem: equal buffers of length %u\n", (UINT32)Length))
+      return Failures;
+  }
+
+  return Failures;
+}
+
+/* The reference copy, volatile so it is not turned back into a CopyMem */
+STATIC VOID ByteCopy(volatile UINT8 *Dest, CONST UINT8 *Source, UINTN Size)
+{
+  for (UINTN Index = 0; Index < Size; Index++)
+    Dest[Index] = Source[Index];
+}
+
+STATIC VOID ByteSet(volatile UINT8 *Dest, UINTN Size, UINT8 Value)
+{
+  for (UINTN Index = 0; Index < Size; Index++)
+    Dest[Index] = Value;
+}
+
+STATIC VOID Benchmark(UINT8 *Source, UINT8 *Dest)
+{
+  UINT64 Start;
+  UINTN  Size;
+  UINTN  Rounds;
+  UINTN  RefRounds;
+
+  for (UINTN Index = 0; Index < ARRAY_SIZE(mBenchSizes); Index++) {
+    Size      = mBenchSizes[Index];
+    Rounds    = MEM_TEST_BENCH_BYTES / Size;
+    RefRounds = MEM_TEST_REF_BYTES / Size;
+
+    Start = GetPerformanceCounter();
+    for (UINTN Round = 0; Round < Rounds; Round++)
+      CopyMem(Dest, Source, Size);
+    SelfTestReportRate(L"CopyMem", Size, MEM_TEST_BENCH_BYTES, Start);
+
+    Start = GetPerformanceCounter();
+    for (UINTN Round = 0; Round < RefRounds; Round++)
+      ByteCopy(Dest, Source, Size);
+    SelfTestReportRate(L"byte copy", Size, MEM_TEST_REF_BYTES, Start);
+
+    Start = GetPerformanceCounter();
+    for (UINTN Round = 0; Round < Rounds; Round++)
+      SetMem(Dest, Size, (UINT8)Round);
+    SelfTestReportRate(L"SetMem", Size, MEM_TEST_BENCH_BYTES, Start);
+
+    Start = GetPerformanceCounter();
+    for (UINTN Round = 0; Round < RefRounds; Round++)
+      ByteSet(Dest, Size, (UINT8)Round);
+    SelfTestReportRate(L"byte set", Size, MEM_TEST_REF_BYTES, Start);
+
+    Start = GetPerformanceCounter();
+    for (UINTN Round = 0; Round < Rounds; Round++)
+      ZeroMem(Dest, Size);
+    SelfTestReportRate(L"ZeroMem", Size, MEM_TEST_BENCH_BYTES, Start);
+
+    Start = GetPerformanceCounter();
+    for (UINTN Round = 0; Round < RefRounds; Round++)
+      ByteSet(Dest, Size, 0);
+    SelfTestReportRate(L"byte zero", Size, MEM_TEST_REF_BYTES, Start);
+  }
+}
+
+UINTN MemTestRun(VOID)
+{
+  UINT8 *Source;
+  UINT8 *Actual;
+  UINT8 *Expected;
+  UINT8 *Bench;
+  UINTN  Failures = 0;
+
+  Source   = AllocatePool(MEM_TEST_BUFFER_SIZE);
+  Actual   = AllocatePool(MEM_TEST_BUFFER_SIZE);
+  Expected = AllocatePool(MEM_TEST_BUFFER_SIZE);
+  Bench    = AllocatePages(EFI_SIZE_TO_PAGES(2 * MEM_TEST_BENCH_MAX_SIZE));
+
+  if (Source == NULL || Actual == NULL || Expected == NULL || Bench == NULL) {
+    Print(L"  out of memory\n");
+    Failures = 1;
+    goto exit;
+  }
+
+  Failures += CheckCopy(Source, Actual, Expected);
+  Failures += CheckMove(Actual, Expected);
+  Failures += CheckFill(Actual, Expected);
+  Failures += CheckCompare(Actual, Expected);
+
+  SelfTestFillPattern(Bench, MEM_TEST_BENCH_MAX_SIZE, 0x77);
+  Benchmark(Bench, Bench + MEM_TEST_BENCH_MAX_SIZE);
+
+exit:
+  if (Source != NULL)
+    FreePool(Source);
+  if (Actual != NULL)
+    FreePool(Actual);
+  if (Expected != NULL)
+    FreePool(Expected);
+  if (Bench != NULL)
+    FreePages(Bench, EFI_SIZE_TO_PAGES(2 * MEM_TEST_BENCH_MAX_SIZE));
+
+  return Failures;
+}
@@ -0,0 +1,84 @@
+/** @file
+  Runs every self-test suite and reports the total. Meant to be started
+  from the Shell on the device, the output goes to the console.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/PrintLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+
+#include "SelfTestApp.h"
+
+typedef struct {
+  CONST CHAR16   *Name;
+  SELF_TEST_SUITE Run;
+} SELF_TEST_ENTRY;
+
+STATIC CONST SELF_TEST_ENTRY mSuites[] = {
+    {L"BaseMemoryLib", MemTestRun},
+    {L"FrameBufferBltLib", BltTestRun},
+    {L"TimerLib", TimerTestRun},
+    {L"BaseCryptLib SHA", ShaTestRun},
+};
+
+BOOLEAN
+EFIAPI
+SelfTestCheck(
+    IN OUT UINTN *Failures, IN BOOLEAN Passed, IN CONST CHAR16 *Format, ...)
+{
+  CHAR16  Message[128];
+  VA_LIST Marker;
+
+  if (Passed)
+    return FALSE;
+
+  VA_START(Marker, Format);
+  UnicodeVSPrint(Message, sizeof(Message), Format, Marker);
+  VA_END(Marker);
+
+  Print(L"%s", Message);
+  (*Failures)++;
+  return TRUE;
+}
+
+VOID SelfTestReportRate(
+    IN CONST CHAR16 *Name, IN UINTN Size, IN UINT64 Bytes, IN UINT64 Start)
+{
+  UINT64 Ns;
+
+  Ns = GetTimeInNanoSecond(GetPerformanceCounter() - Start);
+  if (Ns == 0)
+    Ns = 1;
+
+  // Bytes per nanosecond x 1000 is MB/s
+  Print(
+      L"  %-12s %8u bytes: %6lu MB/s\n", Name, (UINT32)Size,
+      DivU64x64Remainder(MultU64x32(Bytes, 1000), Ns, NULL));
+}
+
+VOID SelfTestFillPattern(OUT UINT8 *Buffer, IN UINTN Length, IN UINT8 Seed)
+{
+  for (UINTN Index = 0; Index < Length; Index++)
+    Buffer[Index] = (UINT8)(Index * 7 + (Index >> 8) + Seed);
+}
+
+EFI_STATUS
+EFIAPI
+SelfTestAppEntryPoint(
+    IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
+{
+  UINTN Failures;
+  UINTN Total = 0;
+
+  for (UINTN Index = 0; Index < ARRAY_SIZE(mSuites); Index++) {
+    Print(L"%s:\n", mSuites[Index].Name);
+    Failures = mSuites[Index].Run();
+    Print(
+        L"%s: %a\n", mSuites[Index].Name, Failures == 0 ? "PASS" : "FAIL");
+    Total += Failures;
+  }
+
+  Print(L"%u failed checks\n", (UINT32)Total);
+  return Total == 0 ? EFI_SUCCESS : EFI_ABORTED;
+}
@@ -0,0 +1,51 @@
+/** @file
+  On-target checks and micro-benchmarks for the platform libraries that
+  replace their MdePkg counterparts.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef _SELF_TEST_APP_H_
+#define _SELF_TEST_APP_H_
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiLib.h>
+
+//
+// Each suite prints its own results and returns the number of failed
+// checks.
+//
+typedef UINTN (*SELF_TEST_SUITE)(VOID);
+
+/**
+  Counts and reports a failed check.
+
+  @retval TRUE  Passed is FALSE, the message was printed.
+**/
+BOOLEAN
+EFIAPI
+SelfTestCheck(
+    IN OUT UINTN *Failures, IN BOOLEAN Passed, IN CONST CHAR16 *Format, ...);
+
+/**
+  Prints a throughput line for Bytes processed in the ticks since Start.
+**/
+VOID SelfTestReportRate(
+    IN CONST CHAR16 *Name, IN UINTN Size, IN UINT64 Bytes, IN UINT64 Start);
+
+/**
+  Fills Buffer with a pattern that differs at every offset and per Seed.
+**/
+VOID SelfTestFillPattern(OUT UINT8 *Buffer, IN UINTN Length, IN UINT8 Seed);
+
+UINTN MemTestRun(VOID);
+UINTN BltTestRun(VOID);
+UINTN TimerTestRun(VOID);
+UINTN ShaTestRun(VOID);
+
+#endif // _SELF_TEST_APP_H_
@@ -0,0 +1,172 @@
+/** @file
+  BaseCryptLib SHA-1 and SHA-256 checks against the FIPS 180 example
+  vectors, whole and fed in odd sized pieces across block boundaries,
+  followed by throughput numbers.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/BaseCryptLib.h>
+
+#include "SelfTestApp.h"
+
+// Holds the million 'a' vector and the largest benchmark size
+#define SHA_TEST_BUFFER_SIZE SIZE_1MB
+
+// Data hashed per benchmark, enough for a stable number at every size
+#define SHA_BENCH_BYTES SIZE_32MB
+
+typedef UINTN(EFIAPI *SHA_GET_CONTEXT_SIZE)(VOID);
+typedef BOOLEAN(EFIAPI *SHA_INIT)(OUT VOID *Context);
+typedef BOOLEAN(EFIAPI *SHA_UPDATE)(
+    IN OUT VOID *Context, IN CONST VOID *Data, IN UINTN DataSize);
+typedef BOOLEAN(EFIAPI *SHA_FINAL)(IN OUT VOID *Context, OUT UINT8 *Hash);
+typedef BOOLEAN(EFIAPI *SHA_HASH_ALL)(
+    IN CONST VOID *Data, IN UINTN DataSize, OUT UINT8 *Hash);
+
+typedef struct {
+  CONST CHAR16        *Name;
+  UINTN                DigestSize;
+  SHA_GET_CONTEXT_SIZE GetContextSize;
+  SHA_INIT             Init;
+  SHA_UPDATE           Update;
+  SHA_FINAL            Final;
+  SHA_HASH_ALL         HashAll;
+} SHA_TEST_ALGORITHM;
+
+typedef struct {
+  CONST CHAR8 *Message;
+  UINTN        Repeat;
+  CONST CHAR8 *Sha1;
+  CONST CHAR8 *Sha256;
+} SHA_TEST_VECTOR;
+
+STATIC CONST SHA_TEST_ALGORITHM mAlgorithms[] = {
+    {L"SHA-1", SHA1_DIGEST_SIZE, Sha1GetContextSize, Sha1Init, Sha1Update,
+     Sha1Final, Sha1HashAll},
+    {L"SHA-256", SHA256_DIGEST_SIZE, Sha256GetContextSize, Sha256Init,
+     Sha256Update, Sha256Final, Sha256HashAll},
+};
+
+STATIC CONST SHA_TEST_VECTOR mVectors[] = {
+    {"", 1, "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+     "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d",
+     "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+     "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {"a", 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+     "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+};
+
+STATIC CONST UINTN mBenchSizes[] = {64, SIZE_4KB, SIZE_1MB};
+
+/* The message of Vector repeated, returns its length */
+STATIC UINTN BuildMessage(CONST SHA_TEST_VECTOR *Vector, UINT8 *Buffer)
+{
+  UINTN Length;
+
+  Length = AsciiStrLen(Vector->Message);
+  for (UINTN Index = 0; Index < Vector->Repeat; Index++)
+    CopyMem(Buffer + Index * Length, Vector->Message, Length);
+
+  return Length * Vector->Repeat;
+}
+
+/* Hashes the whole message at once, then in pieces of 1 to 131 bytes */
+STATIC UINTN CheckVector(
+    CONST SHA_TEST_ALGORITHM *Algorithm, CONST SHA_TEST_VECTOR *Vector,
+    UINT8 *Buffer, VOID *Context)
+{
+  UINT8 Expected[SHA256_DIGEST_SIZE];
+  UINT8 Actual[SHA256_DIGEST_SIZE];
+  UINTN Failures = 0;
+  UINTN Length;
+  UINTN Offset;
+  UINTN Piece;
+
+  AsciiStrHexToBytes(
+      Algorithm->DigestSize == SHA1_DIGEST_SIZE ? Vector->Sha1
+                                                : Vector->Sha256,
+      Algorithm->DigestSize * 2, Expected, sizeof(Expected));
+  Length = BuildMessage(Vector, Buffer);
+
+  SetMem(Actual, sizeof(Actual), 0);
+  SelfTestCheck(
+      &Failures,
+      Algorithm->HashAll(Buffer, Length, Actual) &&
+          CompareMem(Actual, Expected, Algorithm->DigestSize) == 0,
+      L"  %s: wrong digest of %u bytes\n", Algorithm->Name, (UINT32)Length);
+
+  SetMem(Actual, sizeof(Actual), 0);
+  if (SelfTestCheck(
+          &Failures, Algorithm->Init(Context), L"  %s: Init failed\n",
+          Algorithm->Name))
+    return Failures;
+
+  for (Offset = 0, Piece = 1; Offset < Length; Offset += Piece) {
+    Piece = MIN(1 + (Offset * 7 + Piece) % 131, Length - Offset);
+    if (!Algorithm->Update(Context, Buffer + Offset, Piece))
+      break;
+  }
+
+  SelfTestCheck(
+      &Failures,
+      Offset >= Length && Algorithm->Final(Context, Actual) &&
+          CompareMem(Actual, Expected, Algorithm->DigestSize) == 0,
+      L"  %s: wrong digest of %u bytes in pieces\n", Algorithm->Name,
+      (UINT32)Length);
+
+  return Failures;
+}
+
+STATIC VOID Benchmark(CONST SHA_TEST_ALGORITHM *Algorithm, UINT8 *Buffer)
+{
+  UINT8  Digest[SHA256_DIGEST_SIZE];
+  UINT64 Start;
+  UINTN  Size;
+
+  for (UINTN Index = 0; Index < ARRAY_SIZE(mBenchSizes); Index++) {
+    Size  = mBenchSizes[Index];
+    Start = GetPerformanceCounter();
+    for (UINTN Round = 0; Round < SHA_BENCH_BYTES / Size; Round++)
+      Algorithm->HashAll(Buffer, Size, Digest);
+    SelfTestReportRate(Algorithm->Name, Size, SHA_BENCH_BYTES, Start);
+  }
+}
+
+UINTN ShaTestRun(VOID)
+{
+  UINT8 *Buffer;
+  VOID  *Context;
+  UINTN  Failures = 0;
+
+  Buffer = AllocatePool(SHA_TEST_BUFFER_SIZE);
+  if (Buffer == NULL) {
+    Print(L"  out of memory\n");
+    return 1;
+  }
+
+  for (UINTN Index = 0; Index < ARRAY_SIZE(mAlgorithms); Index++) {
+    Context = AllocatePool(mAlgorithms[Index].GetContextSize());
+    if (Context == NULL) {
+      Print(L"  out of memory\n");
+      Failures++;
+      break;
+    }
+
+    for (UINTN Vector = 0; Vector < ARRAY_SIZE(mVectors); Vector++)
+      Failures +=
+          CheckVector(&mAlgorithms[Index], &mVectors[Vector], Buffer, Context);
+
+    FreePool(Context);
+  }
+
+  SelfTestFillPattern(Buffer, SIZE_1MB, 0x3A);
+  for (UINTN Index = 0; Index < ARRAY_SIZE(mAlgorithms); Index++)
+    Benchmark(&mAlgorithms[Index], Buffer);
+
+  FreePool(Buffer);
+  return Failures;
+}
@@ -0,0 +1,198 @@
+/** @file
+  TimerLib checks: tick to nanosecond conversion against exact integer
+  math, delays that are never short, and the event stream the delays
+  sleep on, followed by the cost of a conversion.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Library/ArmLib.h>
+
+#include "SelfTestApp.h"
+
+// ArmArchTimerLib asks for an event about every 10us
+#define TIMER_TEST_EVENT_PERIOD_US 10
+
+// Event stream fields, the same in CNTKCTL_EL1 and CNTHCTL_EL2
+#define TIMER_TEST_EVNTEN     BIT2
+#define TIMER_TEST_EVNTI(Ctl) (((Ctl) >> 4) & 0xF)
+
+#define TIMER_TEST_DELAY_ROUNDS 8
+#define TIMER_BENCH_CALLS       1000000
+
+// Around the event period, where the WFE and spin phases hand over
+STATIC CONST UINTN mDelays[] = {0, 1, 5, 9, 10, 11, 21, 100, 1000, 20000};
+
+// Keeps the benchmarked conversions from being optimized out
+STATIC volatile UINT64 mSink;
+
+/* Ticks x 10^9 / Frequency rounded to nearest, without overflowing */
+STATIC UINT64 ExactNanoSeconds(UINT64 Ticks, UINT64 Frequency)
+{
+  UINT64 Remainder;
+  UINT64 Seconds;
+
+  Seconds = DivU64x64Remainder(Ticks, Frequency, &Remainder);
+  return MultU64x32(Seconds, 1000000000U) +
+         DivU64x64Remainder(
+             MultU64x32(Remainder, 1000000000U) + Frequency / 2, Frequency,
+             NULL);
+}
+
+/* The 32.32 factor is off by at most 2^-33 ns per tick, plus rounding */
+STATIC BOOLEAN CheckTicks(UINTN *Failures, UINT64 Ticks, UINT64 Frequency)
+{
+  UINT64 Actual;
+  UINT64 Expected;
+  UINT64 Error;
+
+  Actual   = GetTimeInNanoSecond(Ticks);
+  Expected = ExactNanoSeconds(Ticks, Frequency);
+  Error    = Actual > Expected ? Actual - Expected : Expected - Actual;
+
+  return SelfTestCheck(
+      Failures, Error <= RShiftU64(Ticks, 32) + 1,
+      L"  GetTimeInNanoSecond(%lu) = %lu, expected %lu\n", Ticks, Actual,
+      Expected);
+}
+
+STATIC UINTN CheckConversion(UINT64 Frequency)
+{
+  UINTN Failures = 0;
+
+  // Either side of every power of two up to 2^48 ticks
+  for (UINTN Shift = 1; Shift <= 48; Shift++) {
+    for (INTN Offset = -1; Offset <= 1; Offset++) {
+      if (CheckTicks(&Failures, LShiftU64(1, Shift) + Offset, Frequency))
+        return Failures;
+    }
+  }
+
+  // A second, a minute and an hour of ticks
+  for (UINT64 Seconds = 1; Seconds <= 3600; Seconds *= 60)
+    CheckTicks(&Failures, MultU64x64(Frequency, Seconds), Frequency);
+
+  return Failures;
+}
+
+/* Delays may run long under interrupts, but never short */
+STATIC UINTN CheckDelays(UINT64 Frequency)
+{
+  UINTN  Failures = 0;
+  UINT64 Start;
+  UINT64 Elapsed;
+  UINT64 Minimum;
+  UINT64 Longest;
+
+  for (UINTN Index = 0; Index < ARRAY_SIZE(mDelays); Index++) {
+    Minimum = DivU64x64Remainder(
+        MultU64x64(mDelays[Index], Frequency) + 1000000 - 1, 1000000, NULL);
+    Longest = 0;
+
+    for (UINTN Round = 0; Round < TIMER_TEST_DELAY_ROUNDS; Round++) {
+      Start = GetPerformanceCounter();
+      MicroSecondDelay(mDelays[Index]);
+      Elapsed = GetPerformanceCounter() - Start;
+
+      if (SelfTestCheck(
+              &Failures, Elapsed >= Minimum,
+              L"  MicroSecondDelay(%u): %lu ticks, expected %lu\n",
+              (UINT32)mDelays[Index], Elapsed, Minimum))
+        return Failures;
+      if (Elapsed > Longest)
+        Longest = Elapsed;
+    }
+
+    Print(
+        L"  MicroSecondDelay(%u): longest %lu ns\n", (UINT32)mDelays[Index],
+        GetTimeInNanoSecond(Longest));
+
+    // The nanosecond variant rounds up to whole microseconds
+    Start = GetPerformanceCounter();
+    NanoSecondDelay(mDelays[Index] * 1000 + 1);
+    Elapsed = GetPerformanceCounter() - Start;
+    SelfTestCheck(
+        &Failures, Elapsed >= Minimum,
+        L"  NanoSecondDelay(%u): %lu ticks, expected at least %lu\n",
+        (UINT32)(mDelays[Index] * 1000 + 1), Elapsed, Minimum);
+  }
+
+  return Failures;
+}
+
+#ifdef MDE_CPU_AARCH64
+
+/* The delays sleep in WFE only on a live stream of about the asked rate */
+STATIC UINTN CheckEventStream(UINT64 Frequency)
+{
+  UINTN  Failures = 0;
+  UINTN  CurrentEL;
+  UINTN  Ctl;
+  UINT64 Period;
+
+  CurrentEL = ArmReadCurrentEL();
+  if (CurrentEL == AARCH64_EL1) {
+    __asm__ volatile("mrs %0, cntkctl_el1" : "=r"(Ctl));
+  } else if (CurrentEL == AARCH64_EL2) {
+    __asm__ volatile("mrs %0, cnthctl_el2" : "=r"(Ctl));
+  } else {
+    Print(L"  event stream: not checked at EL%u\n", (UINT32)(CurrentEL >> 2));
+    return 0;
+  }
+
+  if (SelfTestCheck(
+          &Failures, (Ctl & TIMER_TEST_EVNTEN) != 0,
+          L"  event stream: disabled (0x%lx)\n", (UINT64)Ctl))
+    return Failures;
+
+  // EVNTI selects an event every 2^(EVNTI + 1) ticks
+  Period = LShiftU64(1, TIMER_TEST_EVNTI(Ctl) + 1);
+  SelfTestCheck(
+      &Failures,
+      MultU64x32(Period, 1000000) <=
+          MultU64x32(Frequency, TIMER_TEST_EVENT_PERIOD_US),
+      L"  event stream: one event per %lu ticks at %lu Hz\n", Period,
+      Frequency);
+
+  Print(L"  event stream: %lu ns period\n", GetTimeInNanoSecond(Period));
+  return Failures;
+}
+
+#else
+
+#define CheckEventStream(Frequency) 0
+
+#endif
+
+STATIC VOID Benchmark(VOID)
+{
+  UINT64 Start;
+  UINT64 Ns;
+
+  Start = GetPerformanceCounter();
+  for (UINTN Call = 0; Call < TIMER_BENCH_CALLS; Call++)
+    mSink = GetTimeInNanoSecond(Start + Call);
+  Ns = GetTimeInNanoSecond(GetPerformanceCounter() - Start);
+
+  Print(
+      L"  GetTimeInNanoSecond: %lu ps per call\n",
+      DivU64x64Remainder(MultU64x32(Ns, 1000), TIMER_BENCH_CALLS, NULL));
+}
+
+UINTN TimerTestRun(VOID)
+{
+  UINT64 Frequency;
+  UINTN  Failures = 0;
+
+  Frequency = GetPerformanceCounterProperties(NULL, NULL);
+  Print(L"  counter at %lu Hz\n", Frequency);
+  if (SelfTestCheck(&Failures, Frequency != 0, L"  no counter frequency\n"))
+    return Failures;
+
+  Failures += CheckConversion(Frequency);
+  Failures += CheckDelays(Frequency);
+  Failures += CheckEventStream(Frequency);
+
+  Benchmark();
+  return Failures;
+}
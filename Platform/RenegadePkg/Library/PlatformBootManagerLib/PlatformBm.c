@@ -18,13 +18,17 @@
 #include <Library/CapsuleLib.h>
 #include <Library/DevicePathLib.h>
 #include <Library/HobLib.h>
+#include <Library/KeypadDeviceImplLib.h>
 #include <Library/PcdLib.h>
+#include <Library/PrintLib.h>
 #include <Library/UefiBootManagerLib.h>
 #include <Library/UefiLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
 
 #include <Library/MsPlatformDevicesLib.h>
+#include <Library/FrameBufferSerialPortLib.h>
 
+#include <Protocol/BlockIo.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/EsrtManagement.h>
 #include <Protocol/GraphicsOutput.h>
@@ -32,6 +36,7 @@
 #include <Protocol/PciIo.h>
 #include <Protocol/PciRootBridgeIo.h>
 #include <Protocol/PlatformBootManager.h>
+#include <Protocol/SimpleFileSystem.h>
 
 #include "PlatformBm.h"
 
@@ -290,7 +295,8 @@ VOID EFIAPI AddOutput(IN EFI_HANDLE Handle, IN CONST CHAR16 *ReportText)
 STATIC
 UINT16
 PlatformRegisterFvBootOption(
-    CONST EFI_GUID *FileGuid, CHAR16 *Description, UINT32 Attributes)
+    CONST EFI_GUID *FileGuid, CHAR16 *Description, UINT32 Attributes,
+    UINTN Position)
 {
   EFI_STATUS                        Status;
   INTN                              OptionIndex;
@@ -326,7 +332,7 @@ PlatformRegisterFvBootOption(
       EfiBootManagerFindLoadOption(&NewOption, BootOptions, BootOptionCount);
 
   if (OptionIndex == -1) {
-    Status = EfiBootManagerAddLoadOptionVariable(&NewOption, MAX_UINTN);
+    Status = EfiBootManagerAddLoadOptionVariable(&NewOption, Position);
     ASSERT_EFI_ERROR(Status);
   }
   OptionNumber = NewOption.OptionNumber;
@@ -335,6 +341,57 @@ PlatformRegisterFvBootOption(
   return OptionNumber;
 }
 
+#define BOOT_ATTEMPT_VARIABLE L"BootAttemptPending"
+
+//
+// Side button state sampled at the start of BDS.
+//
+STATIC BOOLEAN mKeyHeldAtBoot = FALSE;
+
+STATIC
+VOID EFIAPI PlatformClearBootAttempt(IN EFI_EVENT Event, IN VOID *Context)
+{
+  gBS->CloseEvent(Event);
+  gRT->SetVariable(
+      BOOT_ATTEMPT_VARIABLE, &gRenegadeBootManagerVariableGuid, 0, 0, NULL);
+}
+
+/**
+  Find out whether the previous boot got as far as starting a boot option,
+  and arm the same check for this boot.
+
+  @retval TRUE   The previous boot attempt never started a boot option.
+  @retval FALSE  It did, or this is the first boot.
+**/
+STATIC
+BOOLEAN
+PlatformLastBootFailed(VOID)
+{
+  EFI_STATUS Status;
+  EFI_EVENT  ReadyToBootEvent;
+  UINT8      Pending;
+  UINTN      Size;
+
+  Size   = sizeof(Pending);
+  Status = gRT->GetVariable(
+      BOOT_ATTEMPT_VARIABLE, &gRenegadeBootManagerVariableGuid, NULL, &Size,
+      &Pending);
+
+  //
+  // Cleared at ReadyToBoot, while the variable log still takes writes; it
+  // stops at BeforeExitBootServices.
+  //
+  Pending = 1;
+  gRT->SetVariable(
+      BOOT_ATTEMPT_VARIABLE, &gRenegadeBootManagerVariableGuid,
+      EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+      sizeof(Pending), &Pending);
+  EfiCreateEventReadyToBootEx(
+      TPL_CALLBACK, PlatformClearBootAttempt, NULL, &ReadyToBootEvent);
+
+  return !EFI_ERROR(Status);
+}
+
 STATIC
 VOID GetPlatformOptions(VOID)
 {
@@ -454,7 +511,7 @@ VOID PlatformRegisterOptionsAndKeys(VOID)
   // Register Simple Init GUI APP
   //
   UINT16 OptionSimpleInit = PlatformRegisterFvBootOption(
-      &gSimpleInitFileGuid, L"Simple Init", LOAD_OPTION_ACTIVE);
+      &gSimpleInitFileGuid, L"Simple Init", LOAD_OPTION_ACTIVE, MAX_UINTN);
   Status = EfiBootManagerAddKeyOptionVariable(
       NULL, (UINT16)OptionSimpleInit, 0, &UP, NULL);
 #else
@@ -480,6 +537,26 @@ VOID PlatformRegisterOptionsAndKeys(VOID)
 **/
 VOID EFIAPI PlatformBootManagerBeforeConsole(VOID)
 {
+  BOOLEAN LastBootFailed;
+
+  //
+  // Sample the side buttons once, straight from the GPIOs. An unattended
+  // boot goes without timeout and menu, those only show up when a button
+  // is held or the previous boot never got to start a boot option. That
+  // needs the variable log replayed during DXE (PcdVariableLogDevicePath);
+  // without it every boot looks like the first one.
+  //
+  mKeyHeldAtBoot = KeypadDeviceImplIsAnyKeyPressed();
+  LastBootFailed = PlatformLastBootFailed();
+  if (!mKeyHeldAtBoot && !LastBootFailed) {
+    PcdSet16S(PcdPlatformBootTimeOut, 0);
+  }
+  else {
+    DEBUG(
+        (EFI_D_INFO, "%a: %a, keeping the boot timeout\n", __FUNCTION__,
+         mKeyHeldAtBoot ? "key held" : "last boot failed"));
+  }
+
   //
   // Signal EndOfDxe PI Event
   //
@@ -506,9 +583,12 @@ VOID EFIAPI PlatformBootManagerBeforeConsole(VOID)
 
   //
   // Now add the device path of all handles with GOP on them to ConOut and
-  // ErrOut.
+  // ErrOut, unless FrameBufferSerialPortLib is the only on-screen console.
   //
-  FilterAndProcess(&gEfiGraphicsOutputProtocolGuid, NULL, AddOutput);
+  if (FixedPcdGet8(PcdFrameBufferConsoleRenderer) !=
+      FBCON_RENDERER_SERIAL_PORT_LIB) {
+    FilterAndProcess(&gEfiGraphicsOutputProtocolGuid, NULL, AddOutput);
+  }
 
   //
   // Add the hardcoded short-form USB keyboard device path to ConIn.
@@ -599,6 +679,334 @@ VOID HandleCapsules(VOID)
   }
 }
 
+#define FAST_BOOT_HASH_VARIABLE L"FastBootConfigHash"
+
+//
+// Set when AfterConsole skipped EfiBootManagerConnectAll.
+//
+STATIC BOOLEAN mFastBootConnected = FALSE;
+
+/**
+  Read the boot option BDS is going to try first: BootNext if set, otherwise
+  the head of BootOrder.
+
+  @param[out] Option        The boot option, freed by the caller with
+                            EfiBootManagerFreeLoadOption().
+  @param[out] BootOrderCrc  Crc32 of the BootOrder variable, 0 if unset.
+
+  @retval EFI_SUCCESS    The option was read.
+  @retval EFI_NOT_FOUND  Neither BootNext nor BootOrder is usable.
+**/
+STATIC
+EFI_STATUS
+PlatformGetBootTarget(
+    OUT EFI_BOOT_MANAGER_LOAD_OPTION *Option, OUT UINT32 *BootOrderCrc)
+{
+  EFI_STATUS Status;
+  UINT16 *   BootNext;
+  UINT16 *   BootOrder;
+  UINTN      BootNextSize;
+  UINTN      BootOrderSize;
+  UINT16     OptionNumber;
+  CHAR16     OptionName[sizeof("Boot####")];
+
+  GetEfiGlobalVariable2(L"BootNext", (VOID **)&BootNext, &BootNextSize);
+  GetEfiGlobalVariable2(L"BootOrder", (VOID **)&BootOrder, &BootOrderSize);
+
+  *BootOrderCrc = 0;
+  if (BootOrder != NULL) {
+    gBS->CalculateCrc32(BootOrder, BootOrderSize, BootOrderCrc);
+  }
+
+  if (BootNext != NULL && BootNextSize == sizeof(UINT16)) {
+    OptionNumber = *BootNext;
+  }
+  else if (BootOrder != NULL && BootOrderSize >= sizeof(UINT16)) {
+    OptionNumber = BootOrder[0];
+  }
+  else {
+    Status = EFI_NOT_FOUND;
+    goto exit;
+  }
+
+  UnicodeSPrint(OptionName, sizeof(OptionName), L"Boot%04x", OptionNumber);
+  Status = EfiBootManagerVariableToLoadOption(OptionName, Option);
+
+exit:
+  if (BootNext != NULL) {
+    FreePool(BootNext);
+  }
+  if (BootOrder != NULL) {
+    FreePool(BootOrder);
+  }
+  return Status;
+}
+
+/**
+  Hash what decides whether a targeted connect is still good enough: the
+  firmware version, the boot order and the target's device path.
+**/
+STATIC
+UINT32
+PlatformGetBootConfigHash(
+    IN EFI_BOOT_MANAGER_LOAD_OPTION *Option, IN UINT32 BootOrderCrc)
+{
+  CHAR16 *FirmwareVersion = PcdGetPtr(PcdFirmwareVersionString);
+  UINT32  Parts[4];
+  UINT32  Hash;
+
+  gBS->CalculateCrc32(FirmwareVersion, StrSize(FirmwareVersion), &Parts[0]);
+  gBS->CalculateCrc32(
+      Option->FilePath, GetDevicePathSize(Option->FilePath), &Parts[1]);
+  Parts[2] = gST->FirmwareRevision;
+  Parts[3] = BootOrderCrc;
+
+  gBS->CalculateCrc32(Parts, sizeof(Parts), &Hash);
+  return Hash;
+}
+
+/**
+  Connect only the devices the next boot option needs, leaving the rest of
+  the system unconnected.
+
+  @retval TRUE   The boot target is reachable without connecting everything.
+  @retval FALSE  The caller has to fall back to EfiBootManagerConnectAll().
+**/
+STATIC
+BOOLEAN
+PlatformConnectBootTarget(VOID)
+{
+  EFI_STATUS                   Status;
+  EFI_BOOT_MANAGER_LOAD_OPTION Option;
+  EFI_DEVICE_PATH_PROTOCOL *   Node;
+  UINT32                       BootOrderCrc;
+  UINT32                       Hash;
+  UINT32                       StoredHash;
+  UINTN                        Size;
+  BOOLEAN                      Connected;
+
+  if (!FixedPcdGetBool(PcdPlatformFastBoot)) {
+    return FALSE;
+  }
+
+  //
+  // A key held at this point asks for a hotkey or the boot menu, both of
+  // which want every input and boot device around.
+  //
+  if (mKeyHeldAtBoot ||
+      !EFI_ERROR(gBS->CheckEvent(gST->ConIn->WaitForKey))) {
+    DEBUG((EFI_D_INFO, "%a: key held, connecting all\n", __FUNCTION__));
+    return FALSE;
+  }
+
+  Status = PlatformGetBootTarget(&Option, &BootOrderCrc);
+  if (EFI_ERROR(Status)) {
+    return FALSE;
+  }
+
+  Connected = FALSE;
+  Hash      = PlatformGetBootConfigHash(&Option, BootOrderCrc);
+  Size      = sizeof(StoredHash);
+  Status    = gRT->GetVariable(
+      FAST_BOOT_HASH_VARIABLE, &gRenegadeBootManagerVariableGuid, NULL, &Size,
+      &StoredHash);
+  if (EFI_ERROR(Status) || StoredHash != Hash) {
+    DEBUG(
+        (EFI_D_INFO, "%a: boot configuration changed, connecting all\n",
+         __FUNCTION__));
+    gRT->SetVariable(
+        FAST_BOOT_HASH_VARIABLE, &gRenegadeBootManagerVariableGuid,
+        EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+        sizeof(Hash), &Hash);
+    goto exit;
+  }
+
+  //
+  // Applications in our own firmware volume load without any device, but
+  // SimpleInit and the Shell go looking for storage of any kind once they
+  // run. AndroidBootApp connects the raw disks holding its boot partition
+  // by itself and only falls back to connecting everything when those are
+  // not enough. A short form HD() path is expanded by UefiBootManagerLib
+  // through its cached full path, which connects that path on its own. Any
+  // other short form can only be resolved by connecting everything.
+  //
+  for (Node = Option.FilePath; !IsDevicePathEnd(Node);
+       Node = NextDevicePathNode(Node)) {
+    if (DevicePathType(Node) == MEDIA_DEVICE_PATH &&
+        DevicePathSubType(Node) == MEDIA_PIWG_FW_FILE_DP) {
+      Connected = CompareGuid(
+          &((MEDIA_FW_VOL_FILEPATH_DEVICE_PATH *)Node)->FvFileName,
+          &gAndroidBootAppFileGuid);
+      goto exit;
+    }
+  }
+
+  Node = Option.FilePath;
+  if (DevicePathType(Node) == MEDIA_DEVICE_PATH &&
+      DevicePathSubType(Node) == MEDIA_HARDDRIVE_DP) {
+    Connected = TRUE;
+    goto exit;
+  }
+
+  if ((DevicePathType(Node) == MEDIA_DEVICE_PATH &&
+       DevicePathSubType(Node) == MEDIA_FILEPATH_DP) ||
+      (DevicePathType(Node) == MESSAGING_DEVICE_PATH &&
+       (DevicePathSubType(Node) == MSG_USB_CLASS_DP ||
+        DevicePathSubType(Node) == MSG_USB_WWID_DP ||
+        DevicePathSubType(Node) == MSG_URI_DP))) {
+    goto exit;
+  }
+
+  Status = EfiBootManagerConnectDevicePath(Option.FilePath, NULL);
+  if (EFI_ERROR(Status)) {
+    DEBUG(
+        (EFI_D_WARN, "%a: connecting \"%s\" failed: %r\n", __FUNCTION__,
+         Option.Description, Status));
+    goto exit;
+  }
+
+  Connected = TRUE;
+
+exit:
+  if (Connected) {
+    DEBUG(
+        (EFI_D_INFO, "%a: fast boot to \"%s\"\n", __FUNCTION__,
+         Option.Description));
+  }
+  EfiBootManagerFreeLoadOption(&Option);
+  return Connected;
+}
+
+#define BOOT_TOPOLOGY_VARIABLE L"BootOptionTopology"
+#define BOOT_RESCAN_VARIABLE   L"BootOptionRescan"
+
+/**
+  Summarize what EfiBootManagerRefreshAllBootOption() would find: for every
+  BlockIo handle its device path, which carries the HD() partition GUID,
+  number and extent, its media ID and whether it is removable or holds a
+  file system. Nothing is read from the media, a new boot file on an
+  unchanged file system needs the BootOptionRescan variable.
+
+  Each handle is hashed on its own and the sorted hashes are hashed again,
+  so handle order does not matter.
+**/
+STATIC
+UINT32
+PlatformGetStorageFingerprint(VOID)
+{
+  EFI_STATUS                Status;
+  EFI_HANDLE *              Handles;
+  UINTN                     HandleCount;
+  UINTN                     Index;
+  UINTN                     Slot;
+  EFI_BLOCK_IO_PROTOCOL *   BlockIo;
+  EFI_DEVICE_PATH_PROTOCOL *DevicePath;
+  VOID *                    FileSystem;
+  UINT32 *                  Hashes;
+  UINT32                    Hash;
+  UINT32                    Crc;
+  UINT32                    Media[3];
+
+  Status = gBS->LocateHandleBuffer(
+      ByProtocol, &gEfiBlockIoProtocolGuid, NULL, &HandleCount, &Handles);
+  if (EFI_ERROR(Status)) {
+    return 0;
+  }
+
+  Hashes = AllocatePool(HandleCount * sizeof(UINT32));
+  if (Hashes == NULL) {
+    FreePool(Handles);
+    return 0;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Hash       = 0;
+    DevicePath = DevicePathFromHandle(Handles[Index]);
+    Status     = gBS->HandleProtocol(
+        Handles[Index], &gEfiBlockIoProtocolGuid, (VOID **)&BlockIo);
+    if (!EFI_ERROR(Status) && DevicePath != NULL) {
+      Media[0] = BlockIo->Media->MediaId;
+      Media[1] = (UINT32)BlockIo->Media->RemovableMedia |
+                 (UINT32)BlockIo->Media->MediaPresent << 1 |
+                 (UINT32)BlockIo->Media->LogicalPartition << 2;
+      Media[2] = !EFI_ERROR(gBS->HandleProtocol(
+          Handles[Index], &gEfiSimpleFileSystemProtocolGuid, &FileSystem));
+
+      gBS->CalculateCrc32(DevicePath, GetDevicePathSize(DevicePath), &Hash);
+      gBS->CalculateCrc32(Media, sizeof(Media), &Crc);
+      Hash ^= Crc;
+    }
+
+    for (Slot = Index; Slot > 0 && Hashes[Slot - 1] > Hash; Slot--) {
+      Hashes[Slot] = Hashes[Slot - 1];
+    }
+    Hashes[Slot] = Hash;
+  }
+
+  gBS->CalculateCrc32(Hashes, HandleCount * sizeof(UINT32), &Hash);
+
+  FreePool(Hashes);
+  FreePool(Handles);
+  return Hash;
+}
+
+/**
+  Decide whether the auto-enumerated boot options need refreshing.
+
+  The storage fingerprint of the last refresh is kept in a variable. Setting
+  the BootOptionRescan variable, with any content, forces one full refresh.
+
+  @retval TRUE   Call EfiBootManagerRefreshAllBootOption().
+  @retval FALSE  The boot options on record still match the storage.
+**/
+STATIC
+BOOLEAN
+PlatformBootOptionsStale(VOID)
+{
+  EFI_STATUS Status;
+  UINT32     Fingerprint;
+  UINT32     StoredFingerprint;
+  UINT8      Rescan;
+  UINTN      Size;
+  BOOLEAN    Stale;
+
+  //
+  // Only part of the storage is connected, a refresh now would drop the
+  // options of everything left out.
+  //
+  if (mFastBootConnected) {
+    return FALSE;
+  }
+
+  Size   = sizeof(Rescan);
+  Status = gRT->GetVariable(
+      BOOT_RESCAN_VARIABLE, &gRenegadeBootManagerVariableGuid, NULL, &Size,
+      &Rescan);
+  Stale = Status == EFI_SUCCESS || Status == EFI_BUFFER_TOO_SMALL;
+  if (Stale) {
+    gRT->SetVariable(
+        BOOT_RESCAN_VARIABLE, &gRenegadeBootManagerVariableGuid, 0, 0, NULL);
+  }
+
+  Fingerprint = PlatformGetStorageFingerprint();
+  Size        = sizeof(StoredFingerprint);
+  Status      = gRT->GetVariable(
+      BOOT_TOPOLOGY_VARIABLE, &gRenegadeBootManagerVariableGuid, NULL, &Size,
+      &StoredFingerprint);
+  if (EFI_ERROR(Status) || StoredFingerprint != Fingerprint) {
+    Stale = TRUE;
+    gRT->SetVariable(
+        BOOT_TOPOLOGY_VARIABLE, &gRenegadeBootManagerVariableGuid,
+        EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+        sizeof(Fingerprint), &Fingerprint);
+  }
+
+  DEBUG(
+      (EFI_D_INFO, "%a: storage fingerprint 0x%08x, %a\n", __FUNCTION__,
+       Fingerprint, Stale ? "refreshing" : "unchanged"));
+  return Stale;
+}
+
 #define VERSION_STRING_PREFIX L"Tianocore/EDK2 firmware version "
 
 /**
@@ -654,9 +1062,13 @@ VOID EFIAPI PlatformBootManagerAfterConsole(VOID)
   }
 
   //
-  // Connect the rest of the devices.
+  // Connect the rest of the devices, unless nothing changed since the last
+  // boot and the boot target can be reached on its own.
   //
-  EfiBootManagerConnectAll();
+  mFastBootConnected = PlatformConnectBootTarget();
+  if (!mFastBootConnected) {
+    EfiBootManagerConnectAll();
+  }
 
   //
   // On ARM, there is currently no reason to use the phased capsule
@@ -668,22 +1080,26 @@ VOID EFIAPI PlatformBootManagerAfterConsole(VOID)
   HandleCapsules();
 
   //
-  // Enumerate all possible boot options.
+  // Enumerate all possible boot options, unless the storage they were
+  // enumerated from is unchanged.
   //
-  EfiBootManagerRefreshAllBootOption();
+  if (PlatformBootOptionsStale()) {
+    EfiBootManagerRefreshAllBootOption();
+  }
 
   //
   // Register UEFI Shell
   //
   PlatformRegisterFvBootOption(
-      &gUefiShellFileGuid, L"UEFI Shell", LOAD_OPTION_ACTIVE);
+      &gUefiShellFileGuid, L"UEFI Shell", LOAD_OPTION_ACTIVE, MAX_UINTN);
 
 #ifdef ENABLE_LINUX_SIMPLE_MASS_STORAGE
   //
   // Register Built-in Linux Kernel
   //
   PlatformRegisterFvBootOption(
-      &gLinuxSimpleMassStorageGuid, L"USB Attached SCSI (UAS) Storage", LOAD_OPTION_ACTIVE);
+      &gLinuxSimpleMassStorageGuid, L"USB Attached SCSI (UAS) Storage", LOAD_OPTION_ACTIVE,
+      MAX_UINTN);
 #endif
 
 #ifdef AB_SLOTS_SUPPORT
@@ -691,9 +1107,17 @@ VOID EFIAPI PlatformBootManagerAfterConsole(VOID)
   // Register Switch Slots App
   //
   PlatformRegisterFvBootOption(
-      &gSwitchSlotsAppFileGuid, L"Reboot to other slot", LOAD_OPTION_ACTIVE);
+      &gSwitchSlotsAppFileGuid, L"Reboot to other slot", LOAD_OPTION_ACTIVE,
+      MAX_UINTN);
 #endif
 
+  //
+  // Register the Android boot image loader for the active slot
+  //
+  PlatformRegisterFvBootOption(
+      &gAndroidBootAppFileGuid, L"Linux (boot partition)", LOAD_OPTION_ACTIVE,
+      FixedPcdGetBool(PcdPlatformAndroidBootFirst) ? 0 : MAX_UINTN);
+
   PlatformSetup();
 }
 
@@ -741,4 +1165,57 @@ VOID EFIAPI PlatformBootManagerWaitCallback(UINT16 TimeoutRemain)
 
   If this function returns, BDS attempts to enter an infinite loop.
 **/
-VOID EFIAPI PlatformBootManagerUnableToBoot(VOID) { return; }
+VOID EFIAPI PlatformBootManagerUnableToBoot(VOID)
+{
+  EFI_BOOT_MANAGER_LOAD_OPTION *BootOptions;
+  EFI_BOOT_MANAGER_LOAD_OPTION  BootManagerMenu;
+  EFI_STATUS                    MenuStatus;
+  UINTN                         BootOptionCount;
+  UINTN                         Index;
+
+  if (!mFastBootConnected) {
+    return;
+  }
+
+  //
+  // The targeted connect was not enough. Forget the stored hash so the next
+  // boot connects everything too, and retry the boot order once with all
+  // devices connected.
+  //
+  DEBUG((EFI_D_WARN, "%a: fast boot failed, connecting all\n", __FUNCTION__));
+  mFastBootConnected = FALSE;
+  gRT->SetVariable(
+      FAST_BOOT_HASH_VARIABLE, &gRenegadeBootManagerVariableGuid, 0, 0, NULL);
+
+  EfiBootManagerConnectAll();
+  EfiBootManagerRefreshAllBootOption();
+
+  //
+  // Same walk as BootBootOptions() in BdsDxe: only active, visible options
+  // of the boot category, and an option that returns EFI_SUCCESS (such as
+  // leaving the Shell) ends it in the boot manager menu.
+  //
+  MenuStatus = EfiBootManagerGetBootManagerMenu(&BootManagerMenu);
+  BootOptions =
+      EfiBootManagerGetLoadOptions(&BootOptionCount, LoadOptionTypeBoot);
+  for (Index = 0; Index < BootOptionCount; Index++) {
+    if ((BootOptions[Index].Attributes & LOAD_OPTION_ACTIVE) == 0 ||
+        (BootOptions[Index].Attributes & LOAD_OPTION_HIDDEN) != 0 ||
+        (BootOptions[Index].Attributes & LOAD_OPTION_CATEGORY) !=
+            LOAD_OPTION_CATEGORY_BOOT) {
+      continue;
+    }
+
+    EfiBootManagerBoot(&BootOptions[Index]);
+    if (BootOptions[Index].Status == EFI_SUCCESS) {
+      if (!EFI_ERROR(MenuStatus)) {
+        EfiBootManagerBoot(&BootManagerMenu);
+      }
+      break;
+    }
+  }
+  EfiBootManagerFreeLoadOptions(BootOptions, BootOptionCount);
+  if (!EFI_ERROR(MenuStatus)) {
+    EfiBootManagerFreeLoadOption(&BootManagerMenu);
+  }
+}
@@ -0,0 +1,101 @@
+// VirtioMmioDxe.c: Registers the populated virtio-mmio transports of QEMU virt.
+
+#include <PiDxe.h>
+
+#include <Guid/VirtioMmioTransport.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/IoLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/VirtioMmioDeviceLib.h>
+
+#include <Protocol/DevicePath.h>
+
+// QEMU virt always creates 32 transports, the first -device gets the top one
+#define VIRTIO_MMIO_BASE   0x0A000000
+#define VIRTIO_MMIO_STRIDE 0x200
+#define VIRTIO_MMIO_COUNT  32
+
+#define VIRTIO_MMIO_MAGIC_VALUE 0x000
+#define VIRTIO_MMIO_DEVICE_ID   0x008
+
+#define VIRTIO_MMIO_MAGIC 0x74726976 // "virt"
+
+#pragma pack(1)
+typedef struct {
+  VENDOR_DEVICE_PATH       Vendor;
+  UINT64                   PhysBase;
+  EFI_DEVICE_PATH_PROTOCOL End;
+} VIRTIO_TRANSPORT_DEVICE_PATH;
+#pragma pack()
+
+STATIC
+EFI_STATUS
+InstallTransport(UINTN Base)
+{
+  VIRTIO_TRANSPORT_DEVICE_PATH *DevicePath;
+  EFI_HANDLE                    Handle = NULL;
+  EFI_STATUS                    Status;
+
+  DevicePath = AllocateZeroPool(sizeof(*DevicePath));
+  if (DevicePath == NULL)
+    return EFI_OUT_OF_RESOURCES;
+
+  DevicePath->Vendor.Header.Type    = HARDWARE_DEVICE_PATH;
+  DevicePath->Vendor.Header.SubType = HW_VENDOR_DP;
+  SetDevicePathNodeLength(
+      &DevicePath->Vendor,
+      sizeof(DevicePath->Vendor) + sizeof(DevicePath->PhysBase));
+  CopyGuid(&DevicePath->Vendor.Guid, &gVirtioMmioTransportGuid);
+  DevicePath->PhysBase = Base;
+  SetDevicePathEndNode(&DevicePath->End);
+
+  Status = gBS->InstallProtocolInterface(
+      &Handle, &gEfiDevicePathProtocolGuid, EFI_NATIVE_INTERFACE, DevicePath);
+  if (EFI_ERROR(Status)) {
+    FreePool(DevicePath);
+    return Status;
+  }
+
+  Status = VirtioMmioInstallDevice(Base, Handle);
+  if (EFI_ERROR(Status)) {
+    gBS->UninstallProtocolInterface(
+        Handle, &gEfiDevicePathProtocolGuid, DevicePath);
+    FreePool(DevicePath);
+  }
+
+  return Status;
+}
+
+EFI_STATUS
+EFIAPI
+VirtioMmioDxeInitialize(
+    IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
+{
+  EFI_STATUS Status;
+  UINTN      Base;
+  UINTN      Index;
+
+  // Top down, so the LUs come up in -device order
+  for (Index = VIRTIO_MMIO_COUNT; Index > 0; Index--) {
+    Base = VIRTIO_MMIO_BASE + (Index - 1) * VIRTIO_MMIO_STRIDE;
+
+    // Unused transports read back device ID 0
+    if (MmioRead32(Base + VIRTIO_MMIO_MAGIC_VALUE) != VIRTIO_MMIO_MAGIC ||
+        MmioRead32(Base + VIRTIO_MMIO_DEVICE_ID) == 0)
+      continue;
+
+    Status = InstallTransport(Base);
+    if (EFI_ERROR(Status)) {
+      DEBUG(
+          (EFI_D_ERROR, "%a: transport at 0x%lx: %r\n", __FUNCTION__, Base,
+           Status));
+    }
+  }
+
+  return EFI_SUCCESS;
+}
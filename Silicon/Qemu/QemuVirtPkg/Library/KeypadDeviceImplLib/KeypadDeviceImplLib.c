@@ -0,0 +1,25 @@
+#include <Uefi.h>
+#include <Library/KeypadDeviceImplLib.h>
+#include <Protocol/KeypadDevice.h>
+
+/*
+ * The virt machine has no side buttons. KeypadDxe still runs, it just never
+ * sees a key, so BDS always takes the unattended path.
+ */
+
+EFI_STATUS EFIAPI KeypadDeviceImplReset(KEYPAD_DEVICE_PROTOCOL *This)
+{
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS KeypadDeviceImplGetKeys(
+    KEYPAD_DEVICE_PROTOCOL *This, KEYPAD_RETURN_API *KeypadReturnApi,
+    UINT64 Delta)
+{
+  return EFI_SUCCESS;
+}
+
+BOOLEAN EFIAPI KeypadDeviceImplIsAnyKeyPressed(VOID)
+{
+  return FALSE;
+}
@@ -0,0 +1,36 @@
+#include <Library/BaseLib.h>
+#include <Library/PlatformMemoryMapLib.h>
+
+/*
+ * qemu-system-aarch64 -M virt with -m 2048. The boot stub QEMU writes at the
+ * bottom of RAM and the BootShim image loaded at +0x80000 both live in
+ * "HLOS 0", and are dead once the FD has been copied to 0x50000000. QEMU
+ * places the DTB 128MB into RAM when there is no initrd.
+ */
+static ARM_MEMORY_REGION_DESCRIPTOR_EX gDeviceMemoryDescriptorEx[] = {
+/*                                                    EFI_RESOURCE_ EFI_RESOURCE_ATTRIBUTE_ EFI_MEMORY_TYPE ARM_REGION_ATTRIBUTE_
+     MemLabel(32 Char.),  MemBase,    MemSize, BuildHob, ResourceType, ResourceAttribute, MemoryType, CacheAttributes
+--------------------- Register ---------------------*/
+    {"Periphs",           0x00000000, 0x40000000,  AddMem, MEM_RES, UNCACHEABLE,  RtCode,   NS_DEVICE},
+
+//--------------------- DDR --------------------- */
+
+    {"HLOS 0",            0x40000000, 0x00B00000, AddMem, SYS_MEM, SYS_MEM_CAP, Conv, WRITE_BACK_XN},
+    {"RAM Log",           0x40B00000, 0x00100000, AddMem, MEM_RES, SYS_MEM_CAP, Reserv, UNCACHED_UNBUFFERED_XN},
+    {"UEFI Stack",        0x40C00000, 0x00040000, AddMem, SYS_MEM, SYS_MEM_CAP,  BsData, WRITE_BACK},
+    {"CPU Vectors",       0x40C40000, 0x00010000, AddMem, SYS_MEM, SYS_MEM_CAP,  BsCode, WRITE_BACK},
+    {"HLOS 0 Split",      0x40C50000, 0x073B0000, AddMem, SYS_MEM, SYS_MEM_CAP, Conv, WRITE_BACK_XN},
+    {"Device Tree",       0x48000000, 0x00200000, AddMem, MEM_RES, SYS_MEM_CAP, Reserv, WRITE_BACK_XN},
+    {"HLOS 0 Split 2",    0x48200000, 0x07E00000, AddMem, SYS_MEM, SYS_MEM_CAP, Conv, WRITE_BACK_XN},
+    {"UEFI FD",           0x50000000, 0x00700000, AddMem, SYS_MEM, SYS_MEM_CAP, BsCode, WRITE_BACK},
+    {"HLOS 1",            0x50700000, 0x6F100000, AddMem, SYS_MEM, SYS_MEM_CAP, Conv,   WRITE_BACK},
+    {"Display Reserved",  0xBF800000, 0x00800000, AddMem, MEM_RES, SYS_MEM_CAP, Reserv, WRITE_THROUGH_XN},
+
+
+//------------------- Terminator for MMU ---------------------
+{"Terminator", 0, 0, 0, 0, 0, 0, 0}};
+
+ARM_MEMORY_REGION_DESCRIPTOR_EX *GetPlatformMemoryMap()
+{
+  return gDeviceMemoryDescriptorEx;
+}
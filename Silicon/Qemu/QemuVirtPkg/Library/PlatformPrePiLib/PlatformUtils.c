@@ -0,0 +1,133 @@
+#include <Library/PcdLib.h>
+#include <Library/ArmLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IoLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/HobLib.h>
+#include <Library/SerialPortLib.h>
+#include <Library/PrintLib.h>
+#include <Library/BaseLib.h>
+#include <Library/MemoryMapHelperLib.h>
+#include <Library/PlatformPrePiLib.h>
+
+#include "PlatformUtils.h"
+
+STATIC
+VOID FwCfgReadBytes(OUT VOID *Buffer, IN UINTN Size)
+{
+  UINT8 *Ptr = Buffer;
+
+  while (Size--)
+    *Ptr++ = MmioRead8(FW_CFG_DATA);
+}
+
+/* Returns the selector of the named fw_cfg file, 0 if QEMU does not have it */
+STATIC
+UINT16 FwCfgFindFile(IN CONST CHAR8 *Name)
+{
+  UINT32 Count;
+  UINT32 Size;
+  UINT16 Select;
+  UINT16 Reserved;
+  CHAR8  FileName[56];
+
+  MmioWrite16(FW_CFG_SEL, SwapBytes16(FW_CFG_FILE_DIR));
+  FwCfgReadBytes(&Count, sizeof(Count));
+
+  for (Count = SwapBytes32(Count); Count > 0; Count--) {
+    FwCfgReadBytes(&Size, sizeof(Size));
+    FwCfgReadBytes(&Select, sizeof(Select));
+    FwCfgReadBytes(&Reserved, sizeof(Reserved));
+    FwCfgReadBytes(FileName, sizeof(FileName));
+
+    if (AsciiStrnCmp(FileName, Name, sizeof(FileName)) == 0)
+      return SwapBytes16(Select);
+  }
+
+  return 0;
+}
+
+/*
+ * The MMU and caches are still off here, so QEMU sees the descriptor on the
+ * stack as is. DMA completes before the doorbell write returns.
+ */
+STATIC
+BOOLEAN FwCfgDmaWrite(IN UINT16 Select, IN VOID *Buffer, IN UINT32 Size)
+{
+  volatile FW_CFG_DMA_ACCESS Access;
+
+  Access.Control = SwapBytes32(
+      ((UINT32)Select << 16) | FW_CFG_DMA_CTL_SELECT | FW_CFG_DMA_CTL_WRITE);
+  Access.Length  = SwapBytes32(Size);
+  Access.Address = SwapBytes64((UINT64)(UINTN)Buffer);
+
+  MmioWrite64(FW_CFG_DMA, SwapBytes64((UINT64)(UINTN)&Access));
+
+  while ((SwapBytes32(Access.Control) & ~FW_CFG_DMA_CTL_ERROR) != 0)
+    ;
+
+  return (SwapBytes32(Access.Control) & FW_CFG_DMA_CTL_ERROR) == 0;
+}
+
+/* Points QEMU's ramfb at the reserved display region, -device ramfb */
+STATIC
+VOID RamFbInit(VOID)
+{
+  RAMFB_CONFIG Config;
+  UINT16       Select;
+
+  Select = FwCfgFindFile("etc/ramfb");
+  if (Select == 0)
+    return;
+
+  Config.Address = SwapBytes64(FixedPcdGet32(PcdMipiFrameBufferAddress));
+  Config.FourCC  = SwapBytes32(RAMFB_FOURCC_XR24);
+  Config.Flags   = 0;
+  Config.Width   = SwapBytes32(FixedPcdGet32(PcdMipiFrameBufferWidth));
+  Config.Height  = SwapBytes32(FixedPcdGet32(PcdMipiFrameBufferHeight));
+  Config.Stride  = SwapBytes32(
+      FixedPcdGet32(PcdMipiFrameBufferWidth) *
+      FixedPcdGet32(PcdMipiFrameBufferPixelBpp) / 8);
+
+  FwCfgDmaWrite(Select, &Config, sizeof(Config));
+}
+
+VOID InitializeSharedUartBuffers(VOID)
+{
+  INTN* pFbConPosition = (INTN*)(FixedPcdGet32(PcdMipiFrameBufferAddress) + (FixedPcdGet32(PcdMipiFrameBufferWidth) * 
+                                                                              FixedPcdGet32(PcdMipiFrameBufferHeight) * 
+                                                                              FixedPcdGet32(PcdMipiFrameBufferPixelBpp) / 8));
+
+  *(pFbConPosition + 0) = 0;
+  *(pFbConPosition + 1) = 0;
+}
+
+VOID UartInit(VOID)
+{
+  SerialPortInitialize();
+
+  InitializeSharedUartBuffers();
+
+  DEBUG((EFI_D_INFO, "\nRenegade Project edk2-exynos (AArch64)\n"));
+  DEBUG(
+      (EFI_D_INFO, "Firmware version %s built %a %a\n\n",
+       (CHAR16 *)PcdGetPtr(PcdFirmwareVersionString), __TIME__, __DATE__));
+}
+
+VOID PlatformInitialize()
+{
+  UINT8 *Base = (UINT8 *)(UINTN)FixedPcdGet32(PcdMipiFrameBufferAddress);
+  UINTN  Size = FixedPcdGet32(PcdMipiFrameBufferWidth) *
+               FixedPcdGet32(PcdMipiFrameBufferHeight) *
+               FixedPcdGet32(PcdMipiFrameBufferPixelBpp) / 8;
+  UINTN  i;
+
+  /* Clear screen, then hand it to ramfb */
+  for (i = 0; i < Size; i++) {
+    Base[i] = 0;
+  }
+  RamFbInit();
+
+  UartInit();
+}
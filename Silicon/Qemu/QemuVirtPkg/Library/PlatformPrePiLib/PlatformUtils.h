@@ -0,0 +1,41 @@
+#ifndef _PLATFORM_UTILS_H_
+#define _PLATFORM_UTILS_H_
+
+#include <Library/PcdLib.h>
+
+/* QEMU fw_cfg on the virt machine, all registers are big-endian */
+#define FW_CFG_BASE 0x09020000
+#define FW_CFG_DATA (FW_CFG_BASE + 0x00)
+#define FW_CFG_SEL  (FW_CFG_BASE + 0x08)
+#define FW_CFG_DMA  (FW_CFG_BASE + 0x10)
+
+#define FW_CFG_FILE_DIR 0x0019
+
+#define FW_CFG_DMA_CTL_ERROR  BIT0
+#define FW_CFG_DMA_CTL_SELECT BIT3
+#define FW_CFG_DMA_CTL_WRITE  BIT4
+
+/* DRM_FORMAT_XRGB8888, what SimpleFbDxe reports as BGRX */
+#define RAMFB_FOURCC_XR24 0x34325258
+
+#pragma pack(1)
+typedef struct {
+  UINT32 Control;
+  UINT32 Length;
+  UINT64 Address;
+} FW_CFG_DMA_ACCESS;
+
+/* Layout of the "etc/ramfb" fw_cfg file */
+typedef struct {
+  UINT64 Address;
+  UINT32 FourCC;
+  UINT32 Flags;
+  UINT32 Width;
+  UINT32 Height;
+  UINT32 Stride;
+} RAMFB_CONFIG;
+#pragma pack()
+
+VOID PlatformInitialize();
+
+#endif /* _PLATFORM_UTILS_H_ */
@@ -276,3 +276,21 @@ EFI_STATUS KeypadDeviceImplGetKeys(
     return EFI_SUCCESS;
 }
 
+
+BOOLEAN EFIAPI KeypadDeviceImplIsAnyKeyPressed(VOID)
+{
+  UINTN Index;
+
+  for (Index = 0; Index < (sizeof(KeyList) / sizeof(KeyList[0])); Index++) {
+    KEY_CONTEXT_PRIVATE *Context = KeyList[Index];
+
+    UINT32 PinState =
+        MmioRead32((Context->PioBase + Context->BankOffset) + 0x4);
+
+    // Keys pull their pin low while held
+    if (!(PinState & (1 << Context->PinNum)))
+      return TRUE;
+  }
+
+  return FALSE;
+}
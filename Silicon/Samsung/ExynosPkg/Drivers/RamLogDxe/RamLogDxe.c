@@ -0,0 +1,176 @@
+// RamLogDxe.c: Describes the RAM Log region to the OS as a ramoops node.
+
+#include <PiDxe.h>
+
+#include <Guid/Fdt.h>
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/RamLogLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <libfdt.h>
+
+// The kernel takes whatever precedes the console zone as dmesg records
+#define RAM_LOG_RECORD_SIZE SIZE_64KB
+
+// Room for the reserved-memory node added below
+#define RAM_LOG_FDT_PADDING SIZE_4KB
+
+STATIC
+UINT32
+GetCells(VOID *Fdt, INT32 Node, CONST CHAR8 *Name)
+{
+  CONST UINT32 *Prop;
+  INT32         Length;
+
+  Prop = fdt_getprop(Fdt, Node, Name, &Length);
+  if (Prop == NULL || Length != sizeof(UINT32))
+    return 2;
+
+  return fdt32_to_cpu(*Prop);
+}
+
+STATIC
+VOID
+SetCellsProp(
+    VOID *Fdt, INT32 Node, CONST CHAR8 *Name, UINT64 Address, UINT32 AddressCells,
+    UINT64 Size, UINT32 SizeCells)
+{
+  UINT32 Reg[4];
+  UINTN  Count = 0;
+
+  if (AddressCells == 2)
+    Reg[Count++] = cpu_to_fdt32((UINT32)RShiftU64(Address, 32));
+  Reg[Count++] = cpu_to_fdt32((UINT32)Address);
+
+  if (SizeCells == 2)
+    Reg[Count++] = cpu_to_fdt32((UINT32)RShiftU64(Size, 32));
+  Reg[Count++] = cpu_to_fdt32((UINT32)Size);
+
+  fdt_setprop(Fdt, Node, Name, Reg, Count * sizeof(UINT32));
+}
+
+STATIC
+EFI_STATUS
+AddRamoopsNode(
+    VOID *Fdt, EFI_PHYSICAL_ADDRESS Base, UINTN Size, UINTN ConsoleSize)
+{
+  CHAR8  NodeName[32];
+  INT32  Parent;
+  INT32  Node;
+  UINT32 AddressCells;
+  UINT32 SizeCells;
+
+  Parent = fdt_path_offset(Fdt, "/reserved-memory");
+  if (Parent < 0) {
+    Parent = fdt_add_subnode(Fdt, 0, "reserved-memory");
+    if (Parent < 0)
+      return EFI_OUT_OF_RESOURCES;
+
+    fdt_setprop_u32(Fdt, Parent, "#address-cells", 2);
+    fdt_setprop_u32(Fdt, Parent, "#size-cells", 2);
+    fdt_setprop(Fdt, Parent, "ranges", NULL, 0);
+  }
+
+  AddressCells = GetCells(Fdt, Parent, "#address-cells");
+  SizeCells    = GetCells(Fdt, Parent, "#size-cells");
+
+  AsciiSPrint(NodeName, sizeof(NodeName), "ramoops@%lx", Base);
+
+  // A kernel DT that already carries a ramoops node wins
+  if (fdt_subnode_offset(Fdt, Parent, NodeName) >= 0 ||
+      fdt_node_offset_by_compatible(Fdt, -1, "ramoops") >= 0)
+    return EFI_ALREADY_STARTED;
+
+  Node = fdt_add_subnode(Fdt, Parent, NodeName);
+  if (Node < 0)
+    return EFI_OUT_OF_RESOURCES;
+
+  fdt_setprop_string(Fdt, Node, "compatible", "ramoops");
+  SetCellsProp(Fdt, Node, "reg", Base, AddressCells, Size, SizeCells);
+  fdt_setprop_u32(Fdt, Node, "console-size", (UINT32)ConsoleSize);
+  if (Size - ConsoleSize >= RAM_LOG_RECORD_SIZE)
+    fdt_setprop_u32(Fdt, Node, "record-size", RAM_LOG_RECORD_SIZE);
+
+  return EFI_SUCCESS;
+}
+
+//
+// Runs at ReadyToBoot and whenever a device tree is installed, so a DT
+// that a loader puts in place after ReadyToBoot (AndroidBootApp with a v2
+// boot image) gets the node as well. Installing the patched copy signals
+// the group again, the second pass finds the node and stops.
+//
+STATIC
+VOID
+EFIAPI
+RamLogUpdateFdt(IN EFI_EVENT Event, IN VOID *Context)
+{
+  EFI_STATUS           Status;
+  EFI_PHYSICAL_ADDRESS Base;
+  UINTN                Size;
+  UINTN                ConsoleSize;
+  VOID                *Fdt;
+  VOID                *NewFdt;
+  UINTN                NewSize;
+
+  if (!RamLogGetRegion(&Base, &Size, &ConsoleSize))
+    return;
+
+  // Only present when the firmware hands the OS a device tree
+  Status = EfiGetSystemConfigurationTable(&gFdtTableGuid, &Fdt);
+  if (EFI_ERROR(Status) || fdt_check_header(Fdt) != 0)
+    return;
+
+  // Already patched, or the kernel DT brings its own
+  if (fdt_node_offset_by_compatible(Fdt, -1, "ramoops") >= 0)
+    return;
+
+  NewSize = fdt_totalsize(Fdt) + RAM_LOG_FDT_PADDING;
+  NewFdt  = AllocatePages(EFI_SIZE_TO_PAGES(NewSize));
+  if (NewFdt == NULL)
+    return;
+
+  if (fdt_open_into(Fdt, NewFdt, NewSize) != 0)
+    goto exit;
+
+  Status = AddRamoopsNode(NewFdt, Base, Size, ConsoleSize);
+  if (EFI_ERROR(Status))
+    goto exit;
+
+  fdt_pack(NewFdt);
+
+  Status = gBS->InstallConfigurationTable(&gFdtTableGuid, NewFdt);
+  if (EFI_ERROR(Status))
+    goto exit;
+
+  DEBUG(
+      (EFI_D_INFO, "RamLogDxe: ramoops at 0x%lx, size 0x%lx\n", Base, Size));
+  return;
+
+exit:
+  FreePages(NewFdt, EFI_SIZE_TO_PAGES(NewSize));
+}
+
+EFI_STATUS
+EFIAPI
+RamLogDxeInitialize(
+    IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
+{
+  EFI_STATUS Status;
+  EFI_EVENT  ReadyToBootEvent;
+  EFI_EVENT  FdtInstallEvent;
+
+  Status = gBS->CreateEventEx(
+      EVT_NOTIFY_SIGNAL, TPL_CALLBACK, RamLogUpdateFdt, NULL, &gFdtTableGuid,
+      &FdtInstallEvent);
+  if (EFI_ERROR(Status))
+    return Status;
+
+  return EfiCreateEventReadyToBootEx(
+      TPL_CALLBACK, RamLogUpdateFdt, NULL, &ReadyToBootEvent);
+}
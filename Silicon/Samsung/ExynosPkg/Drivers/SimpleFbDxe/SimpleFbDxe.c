@@ -5,6 +5,7 @@
 #include <Library/DebugLib.h>
 #include <Library/DxeServicesTableLib.h>
 #include <Library/FrameBufferBltLib.h>
+#include <Library/FrameBufferSerialPortLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/PcdLib.h>
 #include <Library/UefiBootServicesTableLib.h>
@@ -59,6 +60,25 @@ DISPLAY_DEVICE_PATH mDisplayDevicePath = {
 STATIC FRAME_BUFFER_CONFIGURE *mFrameBufferBltLibConfigure;
 STATIC UINTN                   mFrameBufferBltLibConfigureSize;
 
+/*
+ * Optional shadow frame buffer. When present, FrameBufferBltLib renders into
+ * cacheable RAM and dirty scanlines are copied to the real frame buffer once
+ * Blt activity settles, or at ExitBootServices.
+ */
+STATIC UINT8    *mShadowFrameBuffer;
+STATIC UINT64   *mShadowDirtyLines;
+STATIC UINTN     mShadowDirtyWords;
+STATIC BOOLEAN   mShadowFlushPending;
+STATIC EFI_EVENT mShadowFlushEvent;
+STATIC EFI_EVENT mShadowExitBootServicesEvent;
+
+/*
+ * When FrameBufferSerialPortLib keeps painting after GOP is up, this timer
+ * puts text on screen that a throttled write left pending, and queues the
+ * rows it painted into the shadow for the next shadow flush.
+ */
+STATIC EFI_EVENT mFbConFlushEvent;
+
 STATIC
 EFI_STATUS
 EFIAPI
@@ -117,6 +137,179 @@ DisplaySetMode(IN EFI_GRAPHICS_OUTPUT_PROTOCOL *This, IN UINT32 ModeNumber)
   return EFI_SUCCESS;
 }
 
+STATIC
+VOID
+ShadowMarkDirty(IN UINTN FirstLine, IN UINTN LineCount)
+{
+  UINTN Line;
+
+  for (Line = FirstLine; Line < FirstLine + LineCount; Line++) {
+    mShadowDirtyLines[Line / 64] |= LShiftU64(1, Line % 64);
+  }
+}
+
+/* Mark scanlines dirty and arm the flush timer. Call at TPL_NOTIFY. */
+STATIC
+VOID
+ShadowQueueFlush(IN UINTN FirstLine, IN UINTN LineCount)
+{
+  ShadowMarkDirty(FirstLine, LineCount);
+  if (!mShadowFlushPending) {
+    mShadowFlushPending = TRUE;
+    gBS->SetTimer(
+        mShadowFlushEvent, TimerRelative,
+        FixedPcdGet32(PcdMipiFrameBufferShadowFlushPeriod));
+  }
+}
+
+/* Copy dirty scanlines to the real frame buffer. Call at TPL_NOTIFY. */
+STATIC
+VOID
+ShadowFlush(VOID)
+{
+  UINT8 *FrameBuffer = (UINT8 *)(UINTN)mDisplay.Mode->FrameBufferBase;
+  UINTN  LineLength =
+      mDisplay.Mode->Info->PixelsPerScanLine * FB_BYTES_PER_PIXEL;
+  UINTN  Height = mDisplay.Mode->Info->VerticalResolution;
+  UINTN  Line   = 0;
+  UINTN  FirstLine;
+  UINTN  Offset;
+  UINTN  Size;
+
+  while (Line < Height) {
+    if (mShadowDirtyLines[Line / 64] == 0) {
+      Line = (Line / 64 + 1) * 64;
+      continue;
+    }
+
+    if ((mShadowDirtyLines[Line / 64] & LShiftU64(1, Line % 64)) == 0) {
+      Line++;
+      continue;
+    }
+
+    /* Coalesce consecutive dirty lines into a single copy */
+    FirstLine = Line;
+    while (Line < Height &&
+           (mShadowDirtyLines[Line / 64] & LShiftU64(1, Line % 64)) != 0) {
+      Line++;
+    }
+
+    Offset = FirstLine * LineLength;
+    Size   = (Line - FirstLine) * LineLength;
+    CopyMem(FrameBuffer + Offset, mShadowFrameBuffer + Offset, Size);
+    WriteBackDataCacheRange(FrameBuffer + Offset, Size);
+  }
+
+  ZeroMem(mShadowDirtyLines, mShadowDirtyWords * sizeof(UINT64));
+  mShadowFlushPending = FALSE;
+}
+
+STATIC
+VOID
+EFIAPI
+FbConFlushTimerHandler(IN EFI_EVENT Event, IN VOID *Context)
+{
+  EFI_TPL Tpl;
+  UINTN   FirstLine;
+  UINTN   LineCount;
+
+  FbConFlushPending();
+
+  if (mShadowFrameBuffer != NULL) {
+    Tpl       = gBS->RaiseTPL(TPL_NOTIFY);
+    LineCount = FbConTakeDirtyLines(&FirstLine);
+    if (LineCount > 0)
+      ShadowQueueFlush(FirstLine, LineCount);
+    gBS->RestoreTPL(Tpl);
+  }
+}
+
+STATIC
+VOID
+EFIAPI
+ShadowFlushTimerHandler(IN EFI_EVENT Event, IN VOID *Context)
+{
+  EFI_TPL Tpl;
+
+  Tpl = gBS->RaiseTPL(TPL_NOTIFY);
+  if (mShadowFlushPending) {
+    ShadowFlush();
+  }
+  gBS->RestoreTPL(Tpl);
+}
+
+STATIC
+VOID
+EFIAPI
+ShadowExitBootServicesHandler(IN EFI_EVENT Event, IN VOID *Context)
+{
+  UINTN FirstLine;
+  UINTN LineCount;
+
+  /* The OS takes over the real frame buffer, make sure it is up to date */
+  LineCount = FbConTakeDirtyLines(&FirstLine);
+  if (LineCount > 0) {
+    ShadowMarkDirty(FirstLine, LineCount);
+    mShadowFlushPending = TRUE;
+  }
+
+  if (mShadowFlushPending) {
+    ShadowFlush();
+  }
+
+  /* The shadow goes away with boot services memory */
+  FbConSetPaintTarget(NULL);
+}
+
+STATIC
+EFI_STATUS
+ShadowInitialize(IN UINTN FrameBufferSize, IN UINTN Height)
+{
+  EFI_STATUS Status;
+
+  mShadowDirtyWords  = (Height + 63) / 64;
+  mShadowDirtyLines  = AllocateZeroPool(mShadowDirtyWords * sizeof(UINT64));
+  mShadowFrameBuffer = AllocatePages(EFI_SIZE_TO_PAGES(FrameBufferSize));
+  if (mShadowDirtyLines == NULL || mShadowFrameBuffer == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto exit;
+  }
+
+  /* Start from what is on screen, reads are served from the shadow */
+  CopyMem(
+      mShadowFrameBuffer, (VOID *)(UINTN)mDisplay.Mode->FrameBufferBase,
+      FrameBufferSize);
+
+  Status = gBS->CreateEvent(
+      EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK, ShadowFlushTimerHandler,
+      NULL, &mShadowFlushEvent);
+  if (EFI_ERROR(Status))
+    goto exit;
+
+  Status = gBS->CreateEventEx(
+      EVT_NOTIFY_SIGNAL, TPL_NOTIFY, ShadowExitBootServicesHandler, NULL,
+      &gEfiEventExitBootServicesGuid, &mShadowExitBootServicesEvent);
+  if (EFI_ERROR(Status)) {
+    gBS->CloseEvent(mShadowFlushEvent);
+    goto exit;
+  }
+
+  return EFI_SUCCESS;
+
+exit:
+  if (mShadowDirtyLines != NULL) {
+    FreePool(mShadowDirtyLines);
+    mShadowDirtyLines = NULL;
+  }
+
+  if (mShadowFrameBuffer != NULL) {
+    FreePages(mShadowFrameBuffer, EFI_SIZE_TO_PAGES(FrameBufferSize));
+    mShadowFrameBuffer = NULL;
+  }
+
+  return Status;
+}
+
 STATIC
 EFI_STATUS
 EFIAPI
@@ -140,6 +333,16 @@ DisplayBlt(
   Status = FrameBufferBlt(
       mFrameBufferBltLibConfigure, BltBuffer, BltOperation, SourceX, SourceY,
       DestinationX, DestinationY, Width, Height, Delta);
+
+  if (mShadowFrameBuffer != NULL) {
+    /* Reads never touch video memory, writes are flushed later */
+    if (!RETURN_ERROR(Status) && BltOperation != EfiBltVideoToBltBuffer)
+      ShadowQueueFlush(DestinationY, Height);
+
+    gBS->RestoreTPL(Tpl);
+    return RETURN_ERROR(Status) ? EFI_INVALID_PARAMETER : EFI_SUCCESS;
+  }
+
   gBS->RestoreTPL(Tpl);
 
   // zhuowei: hack: flush the cache manually since my memory maps are still
@@ -219,31 +422,47 @@ SimpleFbDxeInitialize(
   mDisplay.Mode->FrameBufferBase = FrameBufferAddress;
   mDisplay.Mode->FrameBufferSize = FrameBufferSize;
 
+  // zhuowei: clear the screen to black
+  // UEFI standard requires this, since text is white - see
+  // OvmfPkg/QemuVideoDxe/Gop.c
+  ZeroMem((void *)FrameBufferAddress, FrameBufferSize);
+  // hack: clear cache
+  WriteBackInvalidateDataCacheRange(
+      (void *)FrameBufferAddress, FrameBufferSize);
+  // zhuowei: end
+
+  /* Blt into a cacheable copy, the carveout is slow to read back */
+  VOID *BltTarget = (VOID *)(UINTN)FrameBufferAddress;
+  if (FixedPcdGetBool(PcdMipiFrameBufferShadowEnable)) {
+    Status = ShadowInitialize(FrameBufferSize, MipiFrameBufferHeight);
+    if (EFI_ERROR(Status)) {
+      DEBUG(
+          (EFI_D_ERROR,
+           "SimpleFbDxe: Shadow FrameBuffer unavailable (%r), using direct "
+           "Blt\n",
+           Status));
+    }
+    else {
+      BltTarget = mShadowFrameBuffer;
+    }
+  }
+
   //
   // Create the FrameBufferBltLib configuration.
   //
   Status = FrameBufferBltConfigure(
-      (VOID *)(UINTN)mDisplay.Mode->FrameBufferBase, mDisplay.Mode->Info,
-      mFrameBufferBltLibConfigure, &mFrameBufferBltLibConfigureSize);
+      BltTarget, mDisplay.Mode->Info, mFrameBufferBltLibConfigure,
+      &mFrameBufferBltLibConfigureSize);
   if (Status == RETURN_BUFFER_TOO_SMALL) {
     mFrameBufferBltLibConfigure = AllocatePool(mFrameBufferBltLibConfigureSize);
     if (mFrameBufferBltLibConfigure != NULL) {
       Status = FrameBufferBltConfigure(
-          (VOID *)(UINTN)mDisplay.Mode->FrameBufferBase, mDisplay.Mode->Info,
-          mFrameBufferBltLibConfigure, &mFrameBufferBltLibConfigureSize);
+          BltTarget, mDisplay.Mode->Info, mFrameBufferBltLibConfigure,
+          &mFrameBufferBltLibConfigureSize);
     }
   }
   ASSERT_EFI_ERROR(Status);
 
-  // zhuowei: clear the screen to black
-  // UEFI standard requires this, since text is white - see
-  // OvmfPkg/QemuVideoDxe/Gop.c
-  ZeroMem((void *)FrameBufferAddress, FrameBufferSize);
-  // hack: clear cache
-  WriteBackInvalidateDataCacheRange(
-      (void *)FrameBufferAddress, FrameBufferSize);
-  // zhuowei: end
-
   /* Register handle */
   Status = gBS->InstallMultipleProtocolInterfaces(
       &hUEFIDisplayHandle, &gEfiDevicePathProtocolGuid, &mDisplayDevicePath,
@@ -251,5 +470,25 @@ SimpleFbDxeInitialize(
 
   ASSERT_EFI_ERROR(Status);
 
+  /* Stop FrameBufferSerialPortLib painting over GraphicsConsole */
+  if (!EFI_ERROR(Status))
+    FbConHandOffToGop();
+
+  if (FixedPcdGet8(PcdFrameBufferConsoleRenderer) !=
+      FBCON_RENDERER_GRAPHICS_CONSOLE) {
+    if (!EFI_ERROR(gBS->CreateEvent(
+            EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+            FbConFlushTimerHandler, NULL, &mFbConFlushEvent))) {
+      gBS->SetTimer(
+          mFbConFlushEvent, TimerPeriodic,
+          EFI_TIMER_PERIOD_MILLISECONDS(
+              FixedPcdGet32(PcdFrameBufferConsoleRenderInterval)));
+
+      /* Text painted around the shadow would be overwritten by its flushes */
+      if (mShadowFrameBuffer != NULL)
+        FbConSetPaintTarget(mShadowFrameBuffer);
+    }
+  }
+
   return Status;
 }
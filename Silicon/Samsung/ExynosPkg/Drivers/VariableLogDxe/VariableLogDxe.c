@@ -0,0 +1,932 @@
+// VariableLogDxe.c: Keeps non-volatile variables in a log on a GPT partition.
+//
+// VariableRuntimeDxe runs in emulated non-volatile mode and serves every
+// GetVariable from RAM. This driver sits behind its SetVariable, appends
+// each non-volatile change as a record to a RAM copy of the log, and writes
+// the new records out in one go once a burst of SetVariable calls settles.
+// When the partition shows up, the records of the last boot are put back
+// into the emulated store. With PcdVariableLogDevicePath set, the driver
+// connects that disk itself as soon as its drivers are loaded, so the store
+// is complete before BDS starts; otherwise it waits for BDS to connect it.
+//
+// The partition is never created here. It is a GPT entry of at least 32K
+// named by PcdVariableLogPartitionName, added when the disk is provisioned
+// (tools/QemuVirt/mkdisk.sh for the virt target). Without it, variables
+// stay in RAM for the boot.
+//
+// The partition holds two banks. Only the one with the newest generation
+// is live; a full bank is compacted into the other one, whose header is
+// written last so that an interrupted compaction leaves the old bank live.
+// A torn append only loses the records of that flush.
+
+#include <PiDxe.h>
+
+#include <Guid/EventGroup.h>
+#include <Guid/GlobalVariable.h>
+#include <Protocol/BlockIo.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/DriverBinding.h>
+#include <Protocol/PartitionInfo.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+#define VAR_LOG_SIGNATURE        SIGNATURE_32('E', 'V', 'L', 'G')
+#define VAR_LOG_RECORD_SIGNATURE SIGNATURE_32('E', 'V', 'R', 'C')
+#define VAR_LOG_VERSION          1
+
+// Records start after the header block, block sizes up to 4K are handled
+#define VAR_LOG_HEADER_SPACE SIZE_4KB
+
+// Twice the default emulated store, plenty for the live set plus history
+#define VAR_LOG_MAX_BANK_SIZE SIZE_256KB
+#define VAR_LOG_MIN_BANK_SIZE SIZE_16KB
+
+// Attributes whose writes cannot be replayed without the signer
+#define VAR_LOG_AUTH_ATTRIBUTES                                                \
+  (EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS |                                   \
+   EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS)
+
+#pragma pack(1)
+typedef struct {
+  UINT32 Signature;
+  UINT32 Version;
+  UINT32 Generation;
+  UINT32 BankSize;
+  UINT32 Crc;
+} VAR_LOG_HEADER;
+
+// Followed by the name and the data, padded to 8 bytes. Attributes 0 marks
+// a deleted variable.
+typedef struct {
+  UINT32   Signature;
+  UINT32   Generation;
+  UINT32   Size;
+  UINT32   Attributes;
+  UINT32   NameSize;
+  UINT32   DataSize;
+  EFI_GUID VendorGuid;
+  UINT32   Crc;
+  UINT32   Reserved;
+} VAR_LOG_RECORD;
+#pragma pack()
+
+typedef struct {
+  UINT32  Offset; // of the newest record in mBank
+  BOOLEAN OnDisk; // some record of this variable is in the bank on disk
+} VAR_LOG_ENTRY;
+
+STATIC EFI_SET_VARIABLE mOriginalSetVariable;
+
+STATIC UINT8 *mBank;
+STATIC UINT8 *mSpare;
+STATIC UINT32 mBankSize = VAR_LOG_MAX_BANK_SIZE;
+STATIC UINT32 mBankIndex;
+STATIC UINT32 mGeneration = 1;
+STATIC UINT32 mTail       = VAR_LOG_HEADER_SPACE;
+STATIC UINT32 mFlushed    = VAR_LOG_HEADER_SPACE;
+STATIC BOOLEAN mNeedsHeader;
+
+STATIC VAR_LOG_ENTRY *mEntries;
+STATIC UINTN          mEntryCount;
+STATIC UINTN          mEntryMax;
+
+STATIC EFI_BLOCK_IO_PROTOCOL *mBlockIo;
+STATIC EFI_EVENT              mFlushEvent;
+STATIC EFI_EVENT              mExitEvent;
+STATIC VOID                  *mPartitionRegistration;
+
+// Disk to connect early, NULL to leave it to BDS
+STATIC EFI_DEVICE_PATH_PROTOCOL *mDevicePath;
+
+// Set by the last flush, later changes would not reach the disk
+STATIC BOOLEAN mClosed;
+
+STATIC
+VAR_LOG_RECORD *
+RecordAt(UINT32 Offset)
+{
+  return (VAR_LOG_RECORD *)(mBank + Offset);
+}
+
+STATIC
+UINT32
+RecordCrc(VAR_LOG_RECORD *Record)
+{
+  UINT32 Saved;
+  UINT32 Crc;
+
+  Saved       = Record->Crc;
+  Record->Crc = 0;
+  gBS->CalculateCrc32(
+      Record, sizeof(*Record) + Record->NameSize + Record->DataSize, &Crc);
+  Record->Crc = Saved;
+
+  return Crc;
+}
+
+STATIC
+BOOLEAN
+RecordIsValid(UINT8 *Bank, UINT32 Offset, UINT32 Generation)
+{
+  VAR_LOG_RECORD *Record;
+
+  if (mBankSize - Offset < sizeof(*Record))
+    return FALSE;
+
+  Record = (VAR_LOG_RECORD *)(Bank + Offset);
+  if (Record->Signature != VAR_LOG_RECORD_SIGNATURE ||
+      Record->Generation != Generation || Record->Size > mBankSize - Offset ||
+      Record->NameSize < sizeof(CHAR16) || (Record->NameSize & 1) != 0 ||
+      Record->Size < sizeof(*Record) + Record->NameSize ||
+      Record->Size - sizeof(*Record) - Record->NameSize < Record->DataSize)
+    return FALSE;
+
+  return RecordCrc(Record) == Record->Crc;
+}
+
+STATIC
+CHAR16 *
+RecordName(VAR_LOG_RECORD *Record)
+{
+  return (CHAR16 *)(Record + 1);
+}
+
+STATIC
+VOID *
+RecordData(VAR_LOG_RECORD *Record)
+{
+  return (UINT8 *)(Record + 1) + Record->NameSize;
+}
+
+/**
+  BootNext is consumed by BDS before the partition shows up, a replayed
+  BootNext would take effect one boot late. It is never kept.
+**/
+STATIC
+BOOLEAN
+IsOneShot(CHAR16 *Name, EFI_GUID *Guid)
+{
+  return CompareGuid(Guid, &gEfiGlobalVariableGuid) &&
+         StrCmp(Name, EFI_BOOT_NEXT_VARIABLE_NAME) == 0;
+}
+
+STATIC
+VAR_LOG_ENTRY *
+FindEntryIn(
+    UINT8 *Bank, VAR_LOG_ENTRY *Entries, UINTN Count, CHAR16 *Name,
+    UINTN NameSize, EFI_GUID *Guid)
+{
+  VAR_LOG_RECORD *Record;
+  UINTN           Index;
+
+  for (Index = 0; Index < Count; Index++) {
+    Record = (VAR_LOG_RECORD *)(Bank + Entries[Index].Offset);
+    if (Record->NameSize == NameSize &&
+        CompareGuid(&Record->VendorGuid, Guid) &&
+        CompareMem(RecordName(Record), Name, NameSize) == 0)
+      return &Entries[Index];
+  }
+
+  return NULL;
+}
+
+STATIC
+VAR_LOG_ENTRY *
+FindEntry(CHAR16 *Name, UINTN NameSize, EFI_GUID *Guid)
+{
+  return FindEntryIn(mBank, mEntries, mEntryCount, Name, NameSize, Guid);
+}
+
+STATIC
+VAR_LOG_ENTRY *
+AddEntry(VOID)
+{
+  VAR_LOG_ENTRY *Entries;
+
+  if (mEntryCount == mEntryMax) {
+    Entries = ReallocatePool(
+        mEntryMax * sizeof(VAR_LOG_ENTRY),
+        (mEntryMax + 32) * sizeof(VAR_LOG_ENTRY), mEntries);
+    if (Entries == NULL)
+      return NULL;
+
+    mEntries = Entries;
+    mEntryMax += 32;
+  }
+
+  return &mEntries[mEntryCount++];
+}
+
+STATIC
+VOID
+RemoveEntry(VAR_LOG_ENTRY *Entry)
+{
+  *Entry = mEntries[--mEntryCount];
+}
+
+/**
+  Drop a record that has not been written out yet, it is superseded.
+**/
+STATIC
+VOID
+CutRecord(UINT32 Offset)
+{
+  UINT32 Size;
+  UINTN  Index;
+
+  Size = RecordAt(Offset)->Size;
+  CopyMem(mBank + Offset, mBank + Offset + Size, mTail - Offset - Size);
+  mTail -= Size;
+  ZeroMem(mBank + mTail, Size);
+
+  for (Index = 0; Index < mEntryCount; Index++) {
+    if (mEntries[Index].Offset > Offset)
+      mEntries[Index].Offset -= Size;
+  }
+}
+
+/**
+  Rewrite the live records into the other bank, deleted variables go away.
+  Only RAM is touched, the new bank reaches the disk on the next flush.
+**/
+STATIC
+VOID
+Compact(VOID)
+{
+  VAR_LOG_RECORD *Record;
+  UINT8          *Bank;
+  UINT32          Tail;
+  UINTN           Index;
+
+  ZeroMem(mSpare, mBankSize);
+  Tail = VAR_LOG_HEADER_SPACE;
+  mGeneration++;
+
+  for (Index = 0; Index < mEntryCount;) {
+    Record = RecordAt(mEntries[Index].Offset);
+    if (Record->Attributes == 0) {
+      RemoveEntry(&mEntries[Index]);
+      continue;
+    }
+
+    CopyMem(mSpare + Tail, Record, Record->Size);
+    Record             = (VAR_LOG_RECORD *)(mSpare + Tail);
+    Record->Generation = mGeneration;
+    Record->Crc        = RecordCrc(Record);
+
+    mEntries[Index].Offset = Tail;
+    mEntries[Index].OnDisk = FALSE;
+    Tail += Record->Size;
+    Index++;
+  }
+
+  Bank     = mBank;
+  mBank    = mSpare;
+  mSpare   = Bank;
+  mTail    = Tail;
+  mFlushed = VAR_LOG_HEADER_SPACE;
+
+  // A bank that never made it to the disk is simply redone, the other one
+  // may still be the live bank
+  if (!mNeedsHeader)
+    mBankIndex ^= 1;
+  mNeedsHeader = TRUE;
+}
+
+/**
+  Look up a variable, dropping its newest record if that one has not been
+  written out yet. OnDisk tells whether the bank on disk knows the variable.
+
+  @retval NULL  The variable has no record left in the log.
+**/
+STATIC
+VAR_LOG_ENTRY *
+TakeEntry(CHAR16 *Name, UINTN NameSize, EFI_GUID *Guid, BOOLEAN *OnDisk)
+{
+  VAR_LOG_ENTRY *Entry;
+
+  Entry   = FindEntry(Name, NameSize, Guid);
+  *OnDisk = Entry != NULL && Entry->OnDisk;
+  if (Entry != NULL && Entry->Offset >= mFlushed) {
+    CutRecord(Entry->Offset);
+    RemoveEntry(Entry);
+    Entry = NULL;
+  }
+
+  return Entry;
+}
+
+/**
+  Log the current value of a variable, or its deletion when Attributes is 0.
+**/
+STATIC
+VOID
+AppendRecord(
+    CHAR16 *Name, EFI_GUID *Guid, UINT32 Attributes, UINTN DataSize, VOID *Data)
+{
+  VAR_LOG_ENTRY  *Entry;
+  VAR_LOG_RECORD *Record;
+  UINTN           NameSize;
+  UINTN           Size;
+  BOOLEAN         OnDisk;
+
+  NameSize = StrSize(Name);
+  Size     = ALIGN_VALUE(sizeof(*Record) + NameSize + DataSize, 8);
+
+  Entry = TakeEntry(Name, NameSize, Guid, &OnDisk);
+  if (Size > mBankSize - mTail) {
+    Compact();
+    Entry = TakeEntry(Name, NameSize, Guid, &OnDisk);
+  }
+
+  // Nothing to delete on disk
+  if (Attributes == 0 && !OnDisk)
+    return;
+
+  if (Size > mBankSize - mTail) {
+    DEBUG((EFI_D_ERROR, "VariableLogDxe: log full, %s not kept\n", Name));
+    return;
+  }
+
+  if (Entry == NULL) {
+    Entry = AddEntry();
+    if (Entry == NULL)
+      return;
+  }
+
+  Record             = RecordAt(mTail);
+  Record->Signature  = VAR_LOG_RECORD_SIGNATURE;
+  Record->Generation = mGeneration;
+  Record->Size       = (UINT32)Size;
+  Record->Attributes = Attributes;
+  Record->NameSize   = (UINT32)NameSize;
+  Record->DataSize   = (UINT32)DataSize;
+  CopyGuid(&Record->VendorGuid, Guid);
+  CopyMem(RecordName(Record), Name, NameSize);
+  CopyMem(RecordData(Record), Data, DataSize);
+  Record->Crc = RecordCrc(Record);
+
+  Entry->Offset = mTail;
+  Entry->OnDisk = OnDisk;
+  mTail += (UINT32)Size;
+}
+
+/**
+  Write everything appended since the last flush with a single request,
+  followed by the bank header when the bank is new.
+**/
+STATIC
+VOID
+Flush(VOID)
+{
+  VAR_LOG_HEADER *Header;
+  EFI_STATUS      Status;
+  EFI_LBA         BankLba;
+  UINT32          BlockSize;
+  UINT32          Start;
+  UINT32          End;
+  UINTN           Index;
+
+  if (mBlockIo == NULL || mBlockIo->Media->ReadOnly)
+    return;
+
+  if (mTail == mFlushed && !mNeedsHeader)
+    return;
+
+  // Reclaim here rather than in SetVariable, this runs off the timer
+  if (mTail > mBankSize / 4 * 3)
+    Compact();
+
+  BlockSize = mBlockIo->Media->BlockSize;
+  BankLba   = (EFI_LBA)mBankIndex * (mBankSize / BlockSize);
+  Start     = mFlushed / BlockSize * BlockSize;
+  End       = ALIGN_VALUE(mTail, BlockSize);
+
+  if (End > Start) {
+    Status = mBlockIo->WriteBlocks(
+        mBlockIo, mBlockIo->Media->MediaId, BankLba + Start / BlockSize,
+        End - Start, mBank + Start);
+    if (EFI_ERROR(Status))
+      goto error;
+  }
+
+  if (mNeedsHeader) {
+    Status = mBlockIo->FlushBlocks(mBlockIo);
+    if (EFI_ERROR(Status))
+      goto error;
+
+    Header = (VAR_LOG_HEADER *)mBank;
+    ZeroMem(Header, VAR_LOG_HEADER_SPACE);
+    Header->Signature  = VAR_LOG_SIGNATURE;
+    Header->Version    = VAR_LOG_VERSION;
+    Header->Generation = mGeneration;
+    Header->BankSize   = mBankSize;
+    gBS->CalculateCrc32(Header, sizeof(*Header), &Header->Crc);
+
+    Status = mBlockIo->WriteBlocks(
+        mBlockIo, mBlockIo->Media->MediaId, BankLba,
+        ALIGN_VALUE(sizeof(*Header), BlockSize), Header);
+    if (EFI_ERROR(Status))
+      goto error;
+  }
+
+  Status = mBlockIo->FlushBlocks(mBlockIo);
+  if (EFI_ERROR(Status))
+    goto error;
+
+  DEBUG(
+      (EFI_D_INFO, "VariableLogDxe: wrote 0x%x bytes of bank %u, gen %u\n",
+       End - Start, mBankIndex, mGeneration));
+
+  mFlushed     = mTail;
+  mNeedsHeader = FALSE;
+  for (Index = 0; Index < mEntryCount; Index++)
+    mEntries[Index].OnDisk = TRUE;
+  return;
+
+error:
+  DEBUG((EFI_D_ERROR, "VariableLogDxe: write failed: %r\n", Status));
+}
+
+STATIC
+VOID
+EFIAPI
+FlushNotify(IN EFI_EVENT Event, IN VOID *Context)
+{
+  Flush();
+}
+
+/**
+  Whether a change to the variable goes into the log. Deletes may come
+  without attributes, so for those the stored variable decides.
+**/
+STATIC
+BOOLEAN
+IsLogged(
+    IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid, IN UINT32 Attributes)
+{
+  UINT32 Current;
+  UINTN  Size;
+
+  if ((Attributes & VAR_LOG_AUTH_ATTRIBUTES) != 0 ||
+      IsOneShot(VariableName, VendorGuid))
+    return FALSE;
+  if ((Attributes & EFI_VARIABLE_NON_VOLATILE) != 0)
+    return TRUE;
+
+  Size = 0;
+  return gRT->GetVariable(VariableName, VendorGuid, &Current, &Size, NULL) ==
+             EFI_BUFFER_TOO_SMALL &&
+         (Current & EFI_VARIABLE_NON_VOLATILE) != 0;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+VariableLogSetVariable(
+    IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid, IN UINT32 Attributes,
+    IN UINTN DataSize, IN VOID *Data)
+{
+  EFI_STATUS Status;
+  EFI_TPL    OldTpl;
+  VOID      *Value;
+  UINTN      Size;
+  UINT32     Current;
+  BOOLEAN    Delete;
+
+  // Refuse what would only live until the next boot instead of losing it
+  if (mClosed && IsLogged(VariableName, VendorGuid, Attributes)) {
+    DEBUG(
+        (EFI_D_ERROR, "VariableLogDxe: %s set after the last flush\n",
+         VariableName));
+    return EFI_WRITE_PROTECTED;
+  }
+
+  Status = mOriginalSetVariable(
+      VariableName, VendorGuid, Attributes, DataSize, Data);
+  if (EFI_ERROR(Status) || (Attributes & VAR_LOG_AUTH_ATTRIBUTES) != 0 ||
+      IsOneShot(VariableName, VendorGuid))
+    return Status;
+
+  Delete = (DataSize == 0 && (Attributes & EFI_VARIABLE_APPEND_WRITE) == 0) ||
+           (Attributes & (EFI_VARIABLE_RUNTIME_ACCESS |
+                          EFI_VARIABLE_BOOTSERVICE_ACCESS)) == 0;
+  if (!Delete && (Attributes & EFI_VARIABLE_NON_VOLATILE) == 0)
+    return Status;
+
+  OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+
+  if (Delete) {
+    AppendRecord(VariableName, VendorGuid, 0, 0, NULL);
+  } else if ((Attributes & EFI_VARIABLE_APPEND_WRITE) != 0) {
+    // Log the whole variable, not just the appended part
+    Size  = 0;
+    Value = NULL;
+    if (gRT->GetVariable(VariableName, VendorGuid, NULL, &Size, NULL) ==
+        EFI_BUFFER_TOO_SMALL)
+      Value = AllocatePool(Size);
+    if (Value != NULL &&
+        !EFI_ERROR(gRT->GetVariable(
+            VariableName, VendorGuid, &Current, &Size, Value)))
+      AppendRecord(
+          VariableName, VendorGuid, Current & ~EFI_VARIABLE_APPEND_WRITE,
+          Size, Value);
+    if (Value != NULL)
+      FreePool(Value);
+  } else {
+    AppendRecord(VariableName, VendorGuid, Attributes, DataSize, Data);
+  }
+
+  if (mBlockIo != NULL && (mTail != mFlushed || mNeedsHeader))
+    gBS->SetTimer(
+        mFlushEvent, TimerRelative, PcdGet32(PcdVariableLogFlushDelay));
+
+  gBS->RestoreTPL(OldTpl);
+  return Status;
+}
+
+STATIC
+BOOLEAN
+HeaderIsValid(VAR_LOG_HEADER *Header)
+{
+  UINT32 Crc;
+  UINT32 Saved;
+
+  if (Header->Signature != VAR_LOG_SIGNATURE ||
+      Header->Version != VAR_LOG_VERSION || Header->BankSize != mBankSize)
+    return FALSE;
+
+  Saved       = Header->Crc;
+  Header->Crc = 0;
+  gBS->CalculateCrc32(Header, sizeof(*Header), &Crc);
+  Header->Crc = Saved;
+
+  return Crc == Saved;
+}
+
+/**
+  Find the live bank on disk and read it into mBank.
+
+  @retval TRUE  mBank holds the bank, mBankIndex and mGeneration are set.
+**/
+STATIC
+BOOLEAN
+ReadLiveBank(EFI_BLOCK_IO_PROTOCOL *BlockIo)
+{
+  EFI_STATUS Status;
+  UINT32     BankBlocks;
+  UINT32     Generation[2];
+  UINT32     Index;
+
+  BankBlocks = mBankSize / BlockIo->Media->BlockSize;
+
+  for (Index = 0; Index < 2; Index++) {
+    Generation[Index] = 0;
+    Status            = BlockIo->ReadBlocks(
+        BlockIo, BlockIo->Media->MediaId, (EFI_LBA)Index * BankBlocks,
+        VAR_LOG_HEADER_SPACE, mBank);
+    if (!EFI_ERROR(Status) && HeaderIsValid((VAR_LOG_HEADER *)mBank))
+      Generation[Index] = ((VAR_LOG_HEADER *)mBank)->Generation;
+  }
+
+  if (Generation[0] == 0 && Generation[1] == 0)
+    return FALSE;
+
+  Index  = Generation[1] > Generation[0] ? 1 : 0;
+  Status = BlockIo->ReadBlocks(
+      BlockIo, BlockIo->Media->MediaId, (EFI_LBA)Index * BankBlocks, mBankSize,
+      mBank);
+  if (EFI_ERROR(Status))
+    return FALSE;
+
+  mBankIndex  = Index;
+  mGeneration = Generation[Index];
+  return TRUE;
+}
+
+/**
+  Take over the log of the last boot. Its variables go back into the
+  variable store, except those already written during this boot, which are
+  newer. Those are appended to the log afterwards.
+**/
+STATIC
+VOID
+AttachPartition(EFI_BLOCK_IO_PROTOCOL *BlockIo)
+{
+  VAR_LOG_ENTRY  *Entry;
+  VAR_LOG_ENTRY  *Pending;
+  VAR_LOG_RECORD *Record;
+  UINT8          *PendingLog;
+  UINT64          PartitionSize;
+  UINT32          BlockSize;
+  UINT32          Offset;
+  UINTN           PendingCount;
+  UINTN           Restored;
+  UINTN           Index;
+
+  BlockSize     = BlockIo->Media->BlockSize;
+  PartitionSize = MultU64x32(BlockIo->Media->LastBlock + 1, BlockSize);
+  if (BlockSize > VAR_LOG_HEADER_SPACE ||
+      VAR_LOG_HEADER_SPACE % BlockSize != 0 ||
+      PartitionSize < 2 * VAR_LOG_MIN_BANK_SIZE) {
+    DEBUG((EFI_D_ERROR, "VariableLogDxe: unusable partition\n"));
+    return;
+  }
+
+  // What this boot has written so far, at the same offsets
+  PendingLog = AllocateCopyPool(mTail, mBank);
+  if (PendingLog == NULL)
+    return;
+
+  Pending      = mEntries;
+  PendingCount = mEntryCount;
+  mEntries     = NULL;
+  mEntryCount  = 0;
+  mEntryMax    = 0;
+
+  // Same bank size on every boot as long as the partition stays the same
+  mBankSize = (UINT32)MIN(
+      DivU64x32(PartitionSize, 2) & ~(UINT64)(VAR_LOG_HEADER_SPACE - 1),
+      VAR_LOG_MAX_BANK_SIZE);
+
+  mTail        = VAR_LOG_HEADER_SPACE;
+  mNeedsHeader = !ReadLiveBank(BlockIo);
+  Restored     = 0;
+
+  if (mNeedsHeader) {
+    ZeroMem(mBank, VAR_LOG_MAX_BANK_SIZE);
+    mBankIndex  = 0;
+    mGeneration = 1;
+  } else {
+    for (Offset = VAR_LOG_HEADER_SPACE;
+         RecordIsValid(mBank, Offset, mGeneration);
+         Offset += RecordAt(Offset)->Size) {
+      Record = RecordAt(Offset);
+      Entry  = FindEntry(RecordName(Record), Record->NameSize, &Record->VendorGuid);
+      if (Entry == NULL) {
+        Entry = AddEntry();
+        if (Entry == NULL)
+          break;
+      }
+
+      Entry->Offset = Offset;
+      Entry->OnDisk = TRUE;
+      mTail         = Offset + Record->Size;
+    }
+
+    // Whatever follows the last good record was torn or is stale
+    ZeroMem(mBank + mTail, mBankSize - mTail);
+
+    for (Index = 0; Index < mEntryCount; Index++) {
+      Record = RecordAt(mEntries[Index].Offset);
+      if (Record->Attributes == 0 ||
+          IsOneShot(RecordName(Record), &Record->VendorGuid) ||
+          FindEntryIn(
+              PendingLog, Pending, PendingCount, RecordName(Record),
+              Record->NameSize, &Record->VendorGuid) != NULL)
+        continue;
+
+      if (!EFI_ERROR(mOriginalSetVariable(
+              RecordName(Record), &Record->VendorGuid, Record->Attributes,
+              Record->DataSize, RecordData(Record))))
+        Restored++;
+    }
+  }
+
+  mFlushed = mTail;
+  mBlockIo = BlockIo;
+
+  // Drop a BootNext kept by an older build of this driver
+  if (!mNeedsHeader) {
+    for (Index = 0; Index < mEntryCount; Index++) {
+      Record = RecordAt(mEntries[Index].Offset);
+      if (Record->Attributes != 0 &&
+          IsOneShot(RecordName(Record), &Record->VendorGuid)) {
+        AppendRecord(
+            EFI_BOOT_NEXT_VARIABLE_NAME, &gEfiGlobalVariableGuid, 0, 0, NULL);
+        break;
+      }
+    }
+  }
+
+  DEBUG(
+      (EFI_D_INFO,
+       "VariableLogDxe: bank %u gen %u, 0x%x bytes, %u variables restored\n",
+       mBankIndex, mGeneration, mTail, (UINT32)Restored));
+
+  // Newer values from this boot go on top
+  for (Index = 0; Index < PendingCount; Index++) {
+    Record = (VAR_LOG_RECORD *)(PendingLog + Pending[Index].Offset);
+    AppendRecord(
+        RecordName(Record), &Record->VendorGuid, Record->Attributes,
+        Record->DataSize, RecordData(Record));
+  }
+
+  FreePool(PendingLog);
+  if (Pending != NULL)
+    FreePool(Pending);
+
+  if (mTail != mFlushed || mNeedsHeader)
+    gBS->SetTimer(
+        mFlushEvent, TimerRelative, PcdGet32(PcdVariableLogFlushDelay));
+}
+
+STATIC
+VOID
+EFIAPI
+PartitionNotify(IN EFI_EVENT Event, IN VOID *Context)
+{
+  EFI_PARTITION_INFO_PROTOCOL *Info;
+  EFI_BLOCK_IO_PROTOCOL       *BlockIo;
+  EFI_HANDLE                   Handle;
+  EFI_STATUS                   Status;
+  UINTN                        Size;
+
+  while (mBlockIo == NULL) {
+    Size   = sizeof(Handle);
+    Status = gBS->LocateHandle(
+        ByRegisterNotify, NULL, mPartitionRegistration, &Size, &Handle);
+    if (EFI_ERROR(Status))
+      return;
+
+    Status = gBS->HandleProtocol(
+        Handle, &gEfiPartitionInfoProtocolGuid, (VOID **)&Info);
+    if (EFI_ERROR(Status) || Info->Type != PARTITION_TYPE_GPT ||
+        StrnCmp(
+            Info->Info.Gpt.PartitionName,
+            (CHAR16 *)PcdGetPtr(PcdVariableLogPartitionName),
+            ARRAY_SIZE(Info->Info.Gpt.PartitionName)) != 0)
+      continue;
+
+    Status =
+        gBS->HandleProtocol(Handle, &gEfiBlockIoProtocolGuid, (VOID **)&BlockIo);
+    if (EFI_ERROR(Status))
+      continue;
+
+    AttachPartition(BlockIo);
+  }
+
+  gBS->CloseEvent(Event);
+}
+
+/**
+  Connect PcdVariableLogDevicePath as far as the drivers loaded so far
+  allow. Runs for every new driver until the partition has been found, so
+  the log is replayed during DXE instead of when BDS connects everything.
+**/
+STATIC
+VOID
+EFIAPI
+DriverNotify(IN EFI_EVENT Event, IN VOID *Context)
+{
+  EFI_DEVICE_PATH_PROTOCOL *Remaining;
+  EFI_HANDLE                Handle;
+  EFI_HANDLE                Previous;
+  EFI_STATUS                Status;
+
+  if (mBlockIo != NULL) {
+    gBS->CloseEvent(Event);
+    return;
+  }
+
+  // Each connect may produce the next handle on the path
+  for (Previous = NULL;; Previous = Handle) {
+    Remaining = mDevicePath;
+    Status    = gBS->LocateDevicePath(
+        &gEfiDevicePathProtocolGuid, &Remaining, &Handle);
+    if (EFI_ERROR(Status) || Handle == Previous)
+      return;
+    if (IsDevicePathEnd(Remaining))
+      break;
+
+    gBS->ConnectController(Handle, NULL, Remaining, FALSE);
+  }
+
+  // The disk and its partitions, PartitionNotify takes it from there
+  gBS->ConnectController(Handle, NULL, NULL, TRUE);
+}
+
+STATIC
+VOID
+EFIAPI
+BeforeExitBootServices(IN EFI_EVENT Event, IN VOID *Context)
+{
+  gBS->SetTimer(mFlushEvent, TimerCancel, 0);
+  Flush();
+
+  // Without a partition nothing is kept anyway, keep the RAM behaviour
+  mClosed = mBlockIo != NULL;
+}
+
+STATIC
+VOID
+EFIAPI
+ExitBootServices(IN EFI_EVENT Event, IN VOID *Context)
+{
+  // The OS talks to VariableRuntimeDxe directly. Handlers queued behind
+  // this one, which only an OS loader can add, reach the RAM store as is.
+  if (gRT->SetVariable == VariableLogSetVariable) {
+    gRT->SetVariable = mOriginalSetVariable;
+    gRT->Hdr.CRC32   = 0;
+    gBS->CalculateCrc32(gRT, gRT->Hdr.HeaderSize, &gRT->Hdr.CRC32);
+  }
+
+  mBlockIo = NULL;
+}
+
+/**
+  Move the ExitBootServices handler behind the ones registered by drivers
+  and BDS, so that changes they make while exiting are refused rather than
+  going to the RAM store behind the log's back.
+**/
+STATIC
+VOID
+EFIAPI
+ReadyToBoot(IN EFI_EVENT Event, IN VOID *Context)
+{
+  EFI_EVENT ExitEvent;
+
+  if (mBlockIo == NULL)
+    DEBUG(
+        (EFI_D_WARN, "VariableLogDxe: no %s partition, nothing is kept\n",
+         (CHAR16 *)PcdGetPtr(PcdVariableLogPartitionName)));
+
+  if (!EFI_ERROR(gBS->CreateEventEx(
+          EVT_NOTIFY_SIGNAL, TPL_CALLBACK, ExitBootServices, NULL,
+          &gEfiEventExitBootServicesGuid, &ExitEvent))) {
+    gBS->CloseEvent(mExitEvent);
+    mExitEvent = ExitEvent;
+  }
+}
+
+EFI_STATUS
+EFIAPI
+VariableLogDxeInitialize(
+    IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
+{
+  EFI_STATUS Status;
+  EFI_EVENT  Event;
+  VOID      *Registration;
+
+  if (StrLen((CHAR16 *)PcdGetPtr(PcdVariableLogPartitionName)) == 0)
+    return EFI_UNSUPPORTED;
+
+  mBank  = AllocateZeroPages(EFI_SIZE_TO_PAGES(VAR_LOG_MAX_BANK_SIZE));
+  mSpare = AllocateZeroPages(EFI_SIZE_TO_PAGES(VAR_LOG_MAX_BANK_SIZE));
+  if (mBank == NULL || mSpare == NULL)
+    return EFI_OUT_OF_RESOURCES;
+
+  Status = gBS->CreateEvent(
+      EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK, FlushNotify, NULL,
+      &mFlushEvent);
+  if (EFI_ERROR(Status))
+    return Status;
+
+  Status = gBS->CreateEventEx(
+      EVT_NOTIFY_SIGNAL, TPL_CALLBACK, BeforeExitBootServices, NULL,
+      &gEfiEventBeforeExitBootServicesGuid, &Event);
+  if (EFI_ERROR(Status))
+    return Status;
+
+  Status = gBS->CreateEventEx(
+      EVT_NOTIFY_SIGNAL, TPL_CALLBACK, ExitBootServices, NULL,
+      &gEfiEventExitBootServicesGuid, &mExitEvent);
+  if (EFI_ERROR(Status))
+    return Status;
+
+  Status = EfiCreateEventReadyToBootEx(
+      TPL_CALLBACK, ReadyToBoot, NULL, &Event);
+  if (EFI_ERROR(Status))
+    return Status;
+
+  EfiCreateProtocolNotifyEvent(
+      &gEfiPartitionInfoProtocolGuid, TPL_CALLBACK, PartitionNotify, NULL,
+      &mPartitionRegistration);
+
+  if (StrLen((CHAR16 *)PcdGetPtr(PcdVariableLogDevicePath)) != 0) {
+    mDevicePath = ConvertTextToDevicePath(
+        (CHAR16 *)PcdGetPtr(PcdVariableLogDevicePath));
+    if (mDevicePath == NULL)
+      DEBUG((EFI_D_ERROR, "VariableLogDxe: bad PcdVariableLogDevicePath\n"));
+    else
+      EfiCreateProtocolNotifyEvent(
+          &gEfiDriverBindingProtocolGuid, TPL_CALLBACK, DriverNotify, NULL,
+          &Registration);
+  }
+
+  // Changes made before the partition shows up are kept in RAM until then
+  mOriginalSetVariable = gRT->SetVariable;
+  gRT->SetVariable     = VariableLogSetVariable;
+  gRT->Hdr.CRC32       = 0;
+  gBS->CalculateCrc32(gRT, gRT->Hdr.HeaderSize, &gRT->Hdr.CRC32);
+
+  return EFI_SUCCESS;
+}
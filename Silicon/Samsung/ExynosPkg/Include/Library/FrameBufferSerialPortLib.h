@@ -28,8 +28,57 @@ enum FbConMsgType {
   FBCON_SELECT_MSG_BG_COLOR,
 };
 
+/*
+ * PcdFrameBufferConsoleRenderer values: which component owns the screen
+ * once GOP is installed.
+ */
+#define FBCON_RENDERER_GRAPHICS_CONSOLE 0
+#define FBCON_RENDERER_SERIAL_PORT_LIB  1
+#define FBCON_RENDERER_BOTH             2
+
+/* Text rows tracked for partial redraws, enough for 3200 lines at 24px */
+#define FBCON_MAX_ROWS 256
+
+/*
+ * State shared by every DXE module's copy of the library, carried in a
+ * gExynosFbConStateHobGuid HOB built by PrePi. The text itself lives in
+ * the RamLogLib ring.
+ */
+typedef struct _FBCON_SHARED_STATE {
+  BOOLEAN GopActive;     // Screen handed to GraphicsConsole, stop painting
+  BOOLEAN GopInstalled;  // GOP may paint the frame buffer too
+  BOOLEAN Rendering;     // A refresh is running, nested writes defer
+  BOOLEAN RenderPending; // Text arrived that is not on screen yet
+  BOOLEAN RenderAgain;   // A forced write came in mid-refresh, redo it
+  BOOLEAN RowsValid;     // RowHash describes what is on screen
+  UINT64  LastRender;    // Counter value of the last screen refresh
+  UINT64  PaintBase;     // GOP's shadow frame buffer to paint into, or 0
+  UINT32  DirtyFirst;    // Text rows painted into PaintBase since GOP last
+  UINT32  DirtyEnd;      // collected them, DirtyEnd 0 when there are none
+  UINT32  RowHash[FBCON_MAX_ROWS]; // Content hash of each text row shown
+} FBCON_SHARED_STATE, *PFBCON_SHARED_STATE;
+
 void ResetFb(void);
 
+/* Returns NULL in SEC and runtime drivers, which keep painting directly */
+FBCON_SHARED_STATE *FbConGetSharedState(void);
+
+/* Called by the GOP producer once the frame buffer is owned by GOP */
+VOID EFIAPI FbConHandOffToGop(VOID);
+
+/* Paints text a throttled write left behind, called from a periodic timer */
+VOID EFIAPI FbConFlushPending(VOID);
+
+/*
+ * Paint into the GOP producer's shadow of the frame buffer instead, NULL
+ * to go back to the real one. The producer copies the lines returned by
+ * FbConTakeDirtyLines() out with its own.
+ */
+VOID EFIAPI FbConSetPaintTarget(IN VOID *FrameBuffer);
+
+/* Pixel lines painted into the shadow since the last call, 0 if none */
+UINTN EFIAPI FbConTakeDirtyLines(OUT UINTN *FirstLine);
+
 UINTN
 EFIAPI
 SerialPortWriteCritical(IN UINT8 *Buffer, IN UINTN NumberOfBytes);
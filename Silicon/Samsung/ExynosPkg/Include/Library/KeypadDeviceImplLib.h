@@ -8,6 +8,9 @@ EFI_STATUS        KeypadDeviceImplGetKeys(
            KEYPAD_DEVICE_PROTOCOL *This, KEYPAD_RETURN_API *KeypadReturnApi,
            UINT64 Delta);
 
+/* Samples the key GPIOs once, without KeypadDxe or its polling timer */
+BOOLEAN EFIAPI KeypadDeviceImplIsAnyKeyPressed(VOID);
+
 
 typedef enum {
   KEYSTATE_RELEASED,
@@ -0,0 +1,41 @@
+#ifndef _RAM_LOG_LIB_H_
+#define _RAM_LOG_LIB_H_
+
+/*
+ * The "RAM Log" memory map region follows the Linux ramoops layout so the
+ * kernel can pick it up as a pstore backend: PcdRamLogConsoleSize bytes at
+ * the end of the region are the console zone UEFI writes to, everything in
+ * front of it is left to the kernel for dmesg records.
+ */
+#define RAM_LOG_REGION_NAME "RAM Log"
+
+/* PERSISTENT_RAM_SIG, "DBGC" */
+#define RAM_LOG_SIGNATURE 0x43474244
+
+/* Matches struct persistent_ram_buffer in fs/pstore/ram_core.c */
+typedef struct _RAM_LOG_BUFFER {
+  UINT32 Signature;
+  UINT32 Start; // Offset of the next byte to write in Data
+  UINT32 Size;  // Valid bytes in Data, saturates at the capacity
+  UINT8  Data[];
+} RAM_LOG_BUFFER, *PRAM_LOG_BUFFER;
+
+/* Validates the ring left by the previous boot, resets it if corrupted */
+RETURN_STATUS EFIAPI RamLogInitialize(VOID);
+
+/* Appends to the ring, dropping the oldest bytes when it is full */
+VOID EFIAPI RamLogWrite(IN CONST UINT8 *Buffer, IN UINTN NumberOfBytes);
+
+/*
+ * Returns the most recent bytes of the ring, at most MaxBytes of them, as up
+ * to two contiguous pieces in write order. Returns the total length.
+ */
+UINTN EFIAPI RamLogGetTail(
+    IN UINTN MaxBytes, OUT CONST UINT8 **First, OUT UINTN *FirstLength,
+    OUT CONST UINT8 **Second, OUT UINTN *SecondLength);
+
+/* Location of the whole region for the OS hand-off, FALSE if there is none */
+BOOLEAN EFIAPI RamLogGetRegion(
+    OUT EFI_PHYSICAL_ADDRESS *Base, OUT UINTN *Size, OUT UINTN *ConsoleSize);
+
+#endif /* _RAM_LOG_LIB_H_ */
@@ -13,8 +13,6 @@
 #include <Library/PcdLib.h>
 #include <Library/ArmGenericTimerCounterLib.h>
 
-#define TICKS_PER_MICRO_SEC  (PcdGet32 (PcdArmArchTimerFreqInHz)/1000000U)
-
 // Select appropriate multiply function for platform architecture.
 #ifdef MDE_CPU_ARM
 #define MULT_U64_X_N  MultU64x32
@@ -22,24 +20,30 @@
 #define MULT_U64_X_N  MultU64x64
 #endif
 
-RETURN_STATUS
-EFIAPI
-TimerConstructor (
-  VOID
-  )
-{
-  //
-  // Check if the ARM Generic Timer Extension is implemented.
-  //
-  if (ArmIsArchTimerImplemented ()) {
-    DEBUG ((DEBUG_WARN, "CNTFRQ_EL0 ARM Register is NULL!\n"));
-  } else {
-    DEBUG ((DEBUG_ERROR, "ARM Architectural Timer is not available in the CPU, hence this library cannot be used.\n"));
-    ASSERT (0);
-  }
+//
+// CNTKCTL_EL1 and CNTHCTL_EL2 share the event stream field layout
+//
+#define CNTCTL_EVNTEN          BIT2
+#define CNTCTL_EVNTDIR         BIT3
+#define CNTCTL_EVNTI_SHIFT     4
+#define CNTCTL_EVNTI_MASK      (0xF << CNTCTL_EVNTI_SHIFT)
 
-  return RETURN_SUCCESS;
-}
+//
+// Rate of the event stream WFE waits on, about one event every 10us
+//
+#define EVENT_STREAM_FREQ_HZ   100000U
+
+//
+// Conversions are done in 32.32 fixed point, precomputed from the timer
+// frequency the first time they are needed:
+//   Ticks       = MicroSeconds x mTicksPerUs
+//   NanoSeconds = Ticks x mNsPerTick
+//
+STATIC UINT32  mTimerFreq;
+STATIC UINT32  mTicksPerUsInt;
+STATIC UINT32  mTicksPerUsFrac;
+STATIC UINT32  mNsPerTickInt;
+STATIC UINT32  mNsPerTickFrac;
 
 /**
   A local utility function that returns the PCD value, if specified.
@@ -62,8 +66,192 @@ GetPlatformTimerFreq (
   return TimerFreq;
 }
 
+/**
+  Multiplies Value by the 32.32 fixed point factor Int + Frac / 2^32.
+  @param  Value     The value to scale.
+  @param  Int       Integer part of the factor.
+  @param  Frac      Fractional part of the factor, in units of 2^-32.
+  @param  RoundUp   TRUE to round the result up, FALSE to round to nearest.
+  @return The scaled value.
+**/
+STATIC
+UINT64
+ScaleFixedPoint (
+  IN  UINT64   Value,
+  IN  UINT32   Int,
+  IN  UINT32   Frac,
+  IN  BOOLEAN  RoundUp
+  )
+{
+  UINT64  Low;
+
+  Low = MULT_U64_X_N (Value & MAX_UINT32, Frac);
+  Low = RShiftU64 (Low + (RoundUp ? MAX_UINT32 : BIT31), 32);
+
+  return MULT_U64_X_N (Value, Int) + MULT_U64_X_N (RShiftU64 (Value, 32), Frac) + Low;
+}
+
+#ifdef MDE_CPU_AARCH64
+
+/**
+  Reads the event stream control of the exception level we run at.
+  @param  Ctl  The CNTKCTL_EL1 or CNTHCTL_EL2 value.
+  @return FALSE if there is no event stream control at this level.
+**/
+STATIC
+BOOLEAN
+ReadEventStreamCtl (
+  OUT UINTN  *Ctl
+  )
+{
+  UINTN  CurrentEL;
+
+  CurrentEL = ArmReadCurrentEL ();
+  if (CurrentEL == AARCH64_EL1) {
+    __asm__ volatile ("mrs %0, cntkctl_el1" : "=r" (*Ctl));
+  } else if (CurrentEL == AARCH64_EL2) {
+    __asm__ volatile ("mrs %0, cnthctl_el2" : "=r" (*Ctl));
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+  Turns on the generic timer event stream, so WFE returns at least once
+  per event period.
+  @param  TimerFreq  The timer frequency.
+**/
+STATIC
+VOID
+EnableEventStream (
+  IN  UINT32  TimerFreq
+  )
+{
+  UINTN  Evnti;
+  UINTN  Ctl;
+
+  if (TimerFreq < EVENT_STREAM_FREQ_HZ * 2) {
+    return;
+  }
+
+  if (!ReadEventStreamCtl (&Ctl)) {
+    return;
+  }
+
+  //
+  // An event fires every 2^(EVNTI + 1) ticks
+  //
+  Evnti = (UINTN)HighBitSet32 (TimerFreq / EVENT_STREAM_FREQ_HZ) - 1;
+  if (Evnti > 15) {
+    Evnti = 15;
+  }
+
+  Ctl &= ~(UINTN)(CNTCTL_EVNTI_MASK | CNTCTL_EVNTDIR);
+  Ctl |= CNTCTL_EVNTEN | (Evnti << CNTCTL_EVNTI_SHIFT);
+
+  if (ArmReadCurrentEL () == AARCH64_EL1) {
+    __asm__ volatile ("msr cntkctl_el1, %0" : : "r" (Ctl));
+  } else {
+    __asm__ volatile ("msr cnthctl_el2, %0" : : "r" (Ctl));
+  }
+
+  __asm__ volatile ("isb" : : : "memory");
+}
+
+/**
+  Returns the live event stream period. It is read on every delay because
+  the OS owns the setting once runtime drivers run under it.
+  @return The event period in ticks, or 0 if the stream is off.
+**/
+STATIC
+UINT64
+GetEventStreamTicks (
+  VOID
+  )
+{
+  UINTN  Ctl;
+
+  if (!ReadEventStreamCtl (&Ctl) || ((Ctl & CNTCTL_EVNTEN) == 0)) {
+    return 0;
+  }
+
+  return LShiftU64 (1, ((Ctl & CNTCTL_EVNTI_MASK) >> CNTCTL_EVNTI_SHIFT) + 1);
+}
+
+#define WAIT_FOR_EVENT()  __asm__ volatile ("wfe" : : : "memory")
+
+#else
+
+#define EnableEventStream(TimerFreq)
+#define GetEventStreamTicks()         0
+#define WAIT_FOR_EVENT()
+
+#endif
+
+/**
+  Precomputes the conversion factors, once per module.
+**/
+STATIC
+VOID
+TimerInitialize (
+  VOID
+  )
+{
+  UINT32  TimerFreq;
+
+  TimerFreq = (UINT32)GetPlatformTimerFreq ();
+  ASSERT (TimerFreq != 0);
+  if (TimerFreq == 0) {
+    return;
+  }
+
+  //
+  // Round the delay factor up so delays are never short, the time factor
+  // to nearest.
+  //
+  mTicksPerUsInt  = TimerFreq / 1000000U;
+  mTicksPerUsFrac = (UINT32)DivU64x32 (
+                              LShiftU64 (TimerFreq % 1000000U, 32) + 1000000U - 1,
+                              1000000U
+                              );
+
+  mNsPerTickInt  = 1000000000U / TimerFreq;
+  mNsPerTickFrac = (UINT32)DivU64x32 (
+                             LShiftU64 (1000000000U % TimerFreq, 32) + TimerFreq / 2,
+                             TimerFreq
+                             );
+
+  EnableEventStream (TimerFreq);
+  mTimerFreq = TimerFreq;
+}
+
+RETURN_STATUS
+EFIAPI
+TimerConstructor (
+  VOID
+  )
+{
+  //
+  // Check if the ARM Generic Timer Extension is implemented.
+  //
+  if (ArmIsArchTimerImplemented ()) {
+    DEBUG ((DEBUG_WARN, "CNTFRQ_EL0 ARM Register is NULL!\n"));
+  } else {
+    DEBUG ((DEBUG_ERROR, "ARM Architectural Timer is not available in the CPU, hence this library cannot be used.\n"));
+    ASSERT (0);
+  }
+
+  TimerInitialize ();
+
+  return RETURN_SUCCESS;
+}
+
 /**
   Stalls the CPU for the number of microseconds specified by MicroSeconds.
+  Long delays sleep in WFE between event stream ticks and only spin on the
+  counter for the final period.
   @param  MicroSeconds  The minimum number of microseconds to delay.
   @return The value of MicroSeconds input.
 **/
@@ -75,23 +263,34 @@ MicroSecondDelay (
 {
   UINT64  TimerTicks64;
   UINT64  SystemCounterVal;
+  UINT64  EventStreamTicks;
 
-  // Calculate counter ticks that represent requested delay:
-  //  = MicroSeconds x TICKS_PER_MICRO_SEC
-  //  = MicroSeconds x Frequency.10^-6
-  TimerTicks64 = DivU64x32 (
-                   MULT_U64_X_N (
-                     MicroSeconds,
-                     GetPlatformTimerFreq ()
-                     ),
-                   1000000U
-                   );
+  //
+  // Early SEC callers can run before the constructor
+  //
+  if (mTimerFreq == 0) {
+    TimerInitialize ();
+  }
+
+  TimerTicks64 = ScaleFixedPoint (MicroSeconds, mTicksPerUsInt, mTicksPerUsFrac, TRUE);
 
   // Read System Counter value
   SystemCounterVal = ArmGenericTimerGetSystemCount ();
 
   TimerTicks64 += SystemCounterVal;
 
+  //
+  // Sleep while a whole event period is left, an event is guaranteed
+  // within each one.
+  //
+  EventStreamTicks = GetEventStreamTicks ();
+  if (EventStreamTicks != 0) {
+    while (SystemCounterVal + EventStreamTicks < TimerTicks64) {
+      WAIT_FOR_EVENT ();
+      SystemCounterVal = ArmGenericTimerGetSystemCount ();
+    }
+  }
+
   // Wait until delay count expires.
   while (SystemCounterVal < TimerTicks64) {
     SystemCounterVal = ArmGenericTimerGetSystemCount ();
@@ -195,36 +394,14 @@ GetTimeInNanoSecond (
   IN      UINT64  Ticks
   )
 {
-  UINT64  NanoSeconds;
-  UINT32  Remainder;
-  UINT32  TimerFreq;
+  if (mTimerFreq == 0) {
+    TimerInitialize ();
+  }
 
-  TimerFreq = (UINT32)GetPlatformTimerFreq ();
   //
   //          Ticks
-  // Time = --------- x 1,000,000,000
+  // Time = --------- x 1,000,000,000 = Ticks x mNsPerTick
   //        Frequency
   //
-  NanoSeconds = MULT_U64_X_N (
-                  DivU64x32Remainder (
-                    Ticks,
-                    TimerFreq,
-                    &Remainder
-                    ),
-                  1000000000U
-                  );
-
-  //
-  // Frequency < 0x100000000, so Remainder < 0x100000000, then (Remainder * 1,000,000,000)
-  // will not overflow 64-bit.
-  //
-  NanoSeconds += DivU64x32 (
-                   MULT_U64_X_N (
-                     (UINT64)Remainder,
-                     1000000000U
-                     ),
-                   TimerFreq
-                   );
-
-  return NanoSeconds;
+  return ScaleFixedPoint (Ticks, mNsPerTickInt, mNsPerTickFrac, FALSE);
 }
@@ -0,0 +1,569 @@
+/** @file
+  FrameBufferBltLib - Library to perform blt operations on a frame buffer.
+
+  Exynos variant: only 32-bpp pixel formats are supported, and every
+  scanline operation is handed to the AArch64 NEON kernels in
+  AArch64/BltKernels.S.
+
+  Copyright (c) 2007 - 2018, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/FrameBufferBltLib.h>
+
+struct FRAME_BUFFER_CONFIGURE {
+  UINT32     PixelsPerScanLine;
+  UINT32     Width;
+  UINT32     Height;
+  UINT8      *FrameBuffer;
+  BOOLEAN    SwapRedBlue;
+};
+
+VOID
+EFIAPI
+InternalBltFill32 (
+  OUT UINT32  *Destination,
+  IN  UINTN   Count,
+  IN  UINT32  Pixel
+  );
+
+VOID
+EFIAPI
+InternalBltCopy32 (
+  OUT UINT32        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+VOID
+EFIAPI
+InternalBltCopyBackward32 (
+  OUT UINT32        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+VOID
+EFIAPI
+InternalBltCopySwap32 (
+  OUT UINT32        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+/**
+  Create the configuration for a video frame buffer.
+
+  The configuration is returned in the caller provided buffer.
+
+  @param[in] FrameBuffer       Pointer to the start of the frame buffer.
+  @param[in] FrameBufferInfo   Describes the frame buffer characteristics.
+  @param[in,out] Configure     The created configuration information.
+  @param[in,out] ConfigureSize Size of the configuration information.
+
+  @retval RETURN_SUCCESS            The configuration was successful created.
+  @retval RETURN_BUFFER_TOO_SMALL   The Configure is to too small. The required
+                                    size is returned in ConfigureSize.
+  @retval RETURN_UNSUPPORTED        The requested mode is not supported by
+                                    this implementaion.
+
+**/
+RETURN_STATUS
+EFIAPI
+FrameBufferBltConfigure (
+  IN      VOID                                  *FrameBuffer,
+  IN      EFI_GRAPHICS_OUTPUT_MODE_INFORMATION  *FrameBufferInfo,
+  IN OUT  FRAME_BUFFER_CONFIGURE                *Configure,
+  IN OUT  UINTN                                 *ConfigureSize
+  )
+{
+  BOOLEAN  SwapRedBlue;
+
+  if ((FrameBuffer == NULL) || (FrameBufferInfo == NULL) || (ConfigureSize == NULL)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  switch (FrameBufferInfo->PixelFormat) {
+    case PixelBlueGreenRedReserved8BitPerColor:
+      SwapRedBlue = FALSE;
+      break;
+
+    case PixelRedGreenBlueReserved8BitPerColor:
+      SwapRedBlue = TRUE;
+      break;
+
+    default:
+      //
+      // PixelBitMask formats would need per-channel shifts, no Exynos panel
+      // uses them.
+      //
+      return RETURN_UNSUPPORTED;
+  }
+
+  if (FrameBufferInfo->PixelsPerScanLine < FrameBufferInfo->HorizontalResolution) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  if (*ConfigureSize < sizeof (FRAME_BUFFER_CONFIGURE)) {
+    *ConfigureSize = sizeof (FRAME_BUFFER_CONFIGURE);
+    return RETURN_BUFFER_TOO_SMALL;
+  }
+
+  if (Configure == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Configure->PixelsPerScanLine = FrameBufferInfo->PixelsPerScanLine;
+  Configure->Width             = FrameBufferInfo->HorizontalResolution;
+  Configure->Height            = FrameBufferInfo->VerticalResolution;
+  Configure->FrameBuffer       = (UINT8 *)FrameBuffer;
+  Configure->SwapRedBlue       = SwapRedBlue;
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Return the address of a pixel in the frame buffer.
+
+  @param[in] Configure  Pointer to a configuration which was successfully
+                        created by FrameBufferBltConfigure ().
+  @param[in] X          Column of the pixel.
+  @param[in] Y          Row of the pixel.
+
+  @return Pointer to the pixel.
+
+**/
+STATIC
+UINT32 *
+FrameBufferPixel (
+  IN FRAME_BUFFER_CONFIGURE  *Configure,
+  IN UINTN                   X,
+  IN UINTN                   Y
+  )
+{
+  return (UINT32 *)Configure->FrameBuffer + Y * Configure->PixelsPerScanLine + X;
+}
+
+/**
+  Performs a UEFI Graphics Output Protocol Blt Video Fill.
+
+  @param[in]  Configure     Pointer to a configuration which was successfully
+                            created by FrameBufferBltConfigure ().
+  @param[in]  Color         Color to fill the region with.
+  @param[in]  DestinationX  X location to start fill operation.
+  @param[in]  DestinationY  Y location to start fill operation.
+  @param[in]  Width         Width (in pixels) to fill.
+  @param[in]  Height        Height to fill.
+
+  @retval  RETURN_INVALID_PARAMETER Invalid parameter was passed in.
+  @retval  RETURN_SUCCESS           The video was filled successfully.
+
+**/
+EFI_STATUS
+FrameBufferBltLibVideoFill (
+  IN  FRAME_BUFFER_CONFIGURE         *Configure,
+  IN  EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *Color,
+  IN  UINTN                          DestinationX,
+  IN  UINTN                          DestinationY,
+  IN  UINTN                          Width,
+  IN  UINTN                          Height
+  )
+{
+  UINT32  Pixel;
+  UINTN   IndexY;
+
+  if ((DestinationY + Height > Configure->Height) ||
+      (DestinationX + Width > Configure->Width))
+  {
+    DEBUG ((DEBUG_VERBOSE, "VideoFill: Past screen\n"));
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if ((Width == 0) || (Height == 0)) {
+    DEBUG ((DEBUG_VERBOSE, "VideoFill: Width or Height is 0\n"));
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Pixel = *(UINT32 *)Color;
+  if (Configure->SwapRedBlue) {
+    Pixel = (Pixel & 0xFF00FF00) | ((Pixel >> 16) & 0xFF) | ((Pixel & 0xFF) << 16);
+  }
+
+  //
+  // Full-width fills are one contiguous run.
+  //
+  if (Width == Configure->PixelsPerScanLine) {
+    InternalBltFill32 (
+      FrameBufferPixel (Configure, 0, DestinationY),
+      Width * Height,
+      Pixel
+      );
+    return RETURN_SUCCESS;
+  }
+
+  for (IndexY = DestinationY; IndexY < DestinationY + Height; IndexY++) {
+    InternalBltFill32 (
+      FrameBufferPixel (Configure, DestinationX, IndexY),
+      Width,
+      Pixel
+      );
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Performs a UEFI Graphics Output Protocol Blt Video to Buffer operation
+  with extended parameters.
+
+  @param[in]  Configure     Pointer to a configuration which was successfully
+                            created by FrameBufferBltConfigure ().
+  @param[out] BltBuffer     Output buffer for pixel color data.
+  @param[in]  SourceX       X location within video.
+  @param[in]  SourceY       Y location within video.
+  @param[in]  DestinationX  X location within BltBuffer.
+  @param[in]  DestinationY  Y location within BltBuffer.
+  @param[in]  Width         Width (in pixels).
+  @param[in]  Height        Height.
+  @param[in]  Delta         Number of bytes in a row of BltBuffer.
+
+  @retval RETURN_INVALID_PARAMETER Invalid parameter were passed in.
+  @retval RETURN_SUCCESS           The Blt operation was performed successfully.
+**/
+RETURN_STATUS
+FrameBufferBltLibVideoToBltBuffer (
+  IN     FRAME_BUFFER_CONFIGURE         *Configure,
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL     *BltBuffer,
+  IN     UINTN                          SourceX,
+  IN     UINTN                          SourceY,
+  IN     UINTN                          DestinationX,
+  IN     UINTN                          DestinationY,
+  IN     UINTN                          Width,
+  IN     UINTN                          Height,
+  IN     UINTN                          Delta
+  )
+{
+  UINTN   IndexY;
+  UINT32  *Source;
+  UINT32  *Destination;
+
+  //
+  // Video to BltBuffer: Source is Video, destination is BltBuffer
+  //
+  if ((SourceY + Height > Configure->Height) ||
+      (SourceX + Width > Configure->Width))
+  {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if ((Width == 0) || (Height == 0)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  for (IndexY = 0; IndexY < Height; IndexY++) {
+    Source      = FrameBufferPixel (Configure, SourceX, SourceY + IndexY);
+    Destination = (UINT32 *)((UINT8 *)BltBuffer + (DestinationY + IndexY) * Delta +
+                             DestinationX * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+    if (Configure->SwapRedBlue) {
+      InternalBltCopySwap32 (Destination, Source, Width);
+    } else {
+      InternalBltCopy32 (Destination, Source, Width);
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Performs a UEFI Graphics Output Protocol Blt Buffer to Video operation
+  with extended parameters.
+
+  @param[in]  Configure     Pointer to a configuration which was successfully
+                            created by FrameBufferBltConfigure ().
+  @param[in]  BltBuffer     Output buffer for pixel color data.
+  @param[in]  SourceX       X location within BltBuffer.
+  @param[in]  SourceY       Y location within BltBuffer.
+  @param[in]  DestinationX  X location within video.
+  @param[in]  DestinationY  Y location within video.
+  @param[in]  Width         Width (in pixels).
+  @param[in]  Height        Height.
+  @param[in]  Delta         Number of bytes in a row of BltBuffer.
+
+  @retval RETURN_INVALID_PARAMETER Invalid parameter were passed in.
+  @retval RETURN_SUCCESS           The Blt operation was performed successfully.
+**/
+RETURN_STATUS
+FrameBufferBltLibBufferToVideo (
+  IN  FRAME_BUFFER_CONFIGURE         *Configure,
+  IN  EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *BltBuffer,
+  IN  UINTN                          SourceX,
+  IN  UINTN                          SourceY,
+  IN  UINTN                          DestinationX,
+  IN  UINTN                          DestinationY,
+  IN  UINTN                          Width,
+  IN  UINTN                          Height,
+  IN  UINTN                          Delta
+  )
+{
+  UINTN   IndexY;
+  UINT32  *Source;
+  UINT32  *Destination;
+
+  //
+  // BltBuffer to Video: Source is BltBuffer, destination is Video
+  //
+  if ((DestinationY + Height > Configure->Height) ||
+      (DestinationX + Width > Configure->Width))
+  {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if ((Width == 0) || (Height == 0)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  for (IndexY = 0; IndexY < Height; IndexY++) {
+    Source = (UINT32 *)((UINT8 *)BltBuffer + (SourceY + IndexY) * Delta +
+                        SourceX * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+    Destination = FrameBufferPixel (Configure, DestinationX, DestinationY + IndexY);
+    if (Configure->SwapRedBlue) {
+      InternalBltCopySwap32 (Destination, Source, Width);
+    } else {
+      InternalBltCopy32 (Destination, Source, Width);
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Performs a UEFI Graphics Output Protocol Blt Video to Video operation
+
+  @param[in]  Configure     Pointer to a configuration which was successfully
+                            created by FrameBufferBltConfigure ().
+  @param[in]  SourceX       X location within video.
+  @param[in]  SourceY       Y location within video.
+  @param[in]  DestinationX  X location within video.
+  @param[in]  DestinationY  Y location within video.
+  @param[in]  Width         Width (in pixels).
+  @param[in]  Height        Height.
+
+  @retval RETURN_INVALID_PARAMETER Invalid parameter were passed in.
+  @retval RETURN_SUCCESS           The Blt operation was performed successfully.
+**/
+RETURN_STATUS
+FrameBufferBltLibVideoToVideo (
+  IN  FRAME_BUFFER_CONFIGURE  *Configure,
+  IN  UINTN                   SourceX,
+  IN  UINTN                   SourceY,
+  IN  UINTN                   DestinationX,
+  IN  UINTN                   DestinationY,
+  IN  UINTN                   Width,
+  IN  UINTN                   Height
+  )
+{
+  UINT32  *Source;
+  UINT32  *Destination;
+  UINTN   LineStride;
+  UINTN   IndexY;
+
+  //
+  // Video to Video: Source is Video, destination is Video
+  //
+  if ((SourceY + Height > Configure->Height) ||
+      (SourceX + Width > Configure->Width))
+  {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if ((DestinationY + Height > Configure->Height) ||
+      (DestinationX + Width > Configure->Width))
+  {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if ((Width == 0) || (Height == 0)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  Source      = FrameBufferPixel (Configure, SourceX, SourceY);
+  Destination = FrameBufferPixel (Configure, DestinationX, DestinationY);
+  if (Source == Destination) {
+    return RETURN_SUCCESS;
+  }
+
+  //
+  // Full-width scrolls move one contiguous block, the kernels cope with the
+  // overlap as long as the direction is right.
+  //
+  if (Width == Configure->PixelsPerScanLine) {
+    if (Destination < Source) {
+      InternalBltCopy32 (Destination, Source, Width * Height);
+    } else {
+      InternalBltCopyBackward32 (Destination, Source, Width * Height);
+    }
+
+    return RETURN_SUCCESS;
+  }
+
+  //
+  // Walk the rows away from the destination so that no source row is
+  // overwritten before it has been copied. Within a row the copy direction
+  // follows the same rule.
+  //
+  LineStride = Configure->PixelsPerScanLine;
+  if (Destination < Source) {
+    for (IndexY = 0; IndexY < Height; IndexY++) {
+      InternalBltCopy32 (
+        Destination + IndexY * LineStride,
+        Source + IndexY * LineStride,
+        Width
+        );
+    }
+  } else if (DestinationY > SourceY) {
+    for (IndexY = Height; IndexY > 0; IndexY--) {
+      InternalBltCopy32 (
+        Destination + (IndexY - 1) * LineStride,
+        Source + (IndexY - 1) * LineStride,
+        Width
+        );
+    }
+  } else {
+    //
+    // Same rows, moving right.
+    //
+    for (IndexY = 0; IndexY < Height; IndexY++) {
+      InternalBltCopyBackward32 (
+        Destination + IndexY * LineStride,
+        Source + IndexY * LineStride,
+        Width
+        );
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Performs a UEFI Graphics Output Protocol Blt operation.
+
+  @param[in]     Configure    Pointer to a configuration which was successfully
+                              created by FrameBufferBltConfigure ().
+  @param[in,out] BltBuffer    The data to transfer to screen.
+  @param[in]     BltOperation The operation to perform.
+  @param[in]     SourceX      The X coordinate of the source for BltOperation.
+  @param[in]     SourceY      The Y coordinate of the source for BltOperation.
+  @param[in]     DestinationX The X coordinate of the destination for
+                              BltOperation.
+  @param[in]     DestinationY The Y coordinate of the destination for
+                              BltOperation.
+  @param[in]     Width        The width of a rectangle in the blt rectangle
+                              in pixels.
+  @param[in]     Height       The height of a rectangle in the blt rectangle
+                              in pixels.
+  @param[in]     Delta        Not used for EfiBltVideoFill and
+                              EfiBltVideoToVideo operation. If a Delta of 0
+                              is used, the entire BltBuffer will be operated
+                              on. If a subrectangle of the BltBuffer is
+                              used, then Delta represents the number of
+                              bytes in a row of the BltBuffer.
+
+  @retval RETURN_INVALID_PARAMETER Invalid parameter were passed in.
+  @retval RETURN_SUCCESS           The Blt operation was performed successfully.
+**/
+RETURN_STATUS
+EFIAPI
+FrameBufferBlt (
+  IN     FRAME_BUFFER_CONFIGURE             *Configure,
+  IN OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL      *BltBuffer  OPTIONAL,
+  IN     EFI_GRAPHICS_OUTPUT_BLT_OPERATION  BltOperation,
+  IN     UINTN                              SourceX,
+  IN     UINTN                              SourceY,
+  IN     UINTN                              DestinationX,
+  IN     UINTN                              DestinationY,
+  IN     UINTN                              Width,
+  IN     UINTN                              Height,
+  IN     UINTN                              Delta
+  )
+{
+  if (Configure == NULL) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  //
+  // If Delta is zero, then the entire BltBuffer is being used, so Delta is
+  // the number of bytes in each row of BltBuffer. Since BltBuffer is Width
+  // pixels size, the number of bytes in each row can be computed.
+  //
+  if (Delta == 0) {
+    Delta = Width * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+  }
+
+  switch (BltOperation) {
+    case EfiBltVideoToBltBuffer:
+      if (BltBuffer == NULL) {
+        return RETURN_INVALID_PARAMETER;
+      }
+
+      return FrameBufferBltLibVideoToBltBuffer (
+               Configure,
+               BltBuffer,
+               SourceX,
+               SourceY,
+               DestinationX,
+               DestinationY,
+               Width,
+               Height,
+               Delta
+               );
+
+    case EfiBltVideoToVideo:
+      return FrameBufferBltLibVideoToVideo (
+               Configure,
+               SourceX,
+               SourceY,
+               DestinationX,
+               DestinationY,
+               Width,
+               Height
+               );
+
+    case EfiBltVideoFill:
+      if (BltBuffer == NULL) {
+        return RETURN_INVALID_PARAMETER;
+      }
+
+      return FrameBufferBltLibVideoFill (
+               Configure,
+               BltBuffer,
+               DestinationX,
+               DestinationY,
+               Width,
+               Height
+               );
+
+    case EfiBltBufferToVideo:
+      if (BltBuffer == NULL) {
+        return RETURN_INVALID_PARAMETER;
+      }
+
+      return FrameBufferBltLibBufferToVideo (
+               Configure,
+               BltBuffer,
+               SourceX,
+               SourceY,
+               DestinationX,
+               DestinationY,
+               Width,
+               Height,
+               Delta
+               );
+
+    default:
+      return RETURN_INVALID_PARAMETER;
+  }
+}
@@ -0,0 +1,137 @@
+#include <Base.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DebugPrintErrorLevelLib.h>
+#include <Library/PcdLib.h>
+#include <Library/PrintLib.h>
+#include <Library/SerialPortLib.h>
+
+#include <Library/FrameBufferSerialPortLib.h>
+
+// Longest DEBUG or ASSERT message, the rest is cut off
+#define MAX_DEBUG_MESSAGE_LENGTH 0x100
+
+// VA_LIST can not initialize to NULL for all compilers
+STATIC VA_LIST mVaListNull;
+
+RETURN_STATUS
+EFIAPI
+FrameBufferDebugLibConstructor(VOID) { return SerialPortInitialize(); }
+
+STATIC
+VOID
+DebugPrintMarker(
+    IN UINTN ErrorLevel, IN CONST CHAR8 *Format, IN VA_LIST VaListMarker,
+    IN BASE_LIST BaseListMarker)
+{
+  CHAR8 Buffer[MAX_DEBUG_MESSAGE_LENGTH];
+
+  ASSERT(Format != NULL);
+
+  if ((ErrorLevel & GetDebugPrintErrorLevel()) == 0)
+    return;
+
+  if (BaseListMarker == NULL)
+    AsciiVSPrint(Buffer, sizeof(Buffer), Format, VaListMarker);
+  else
+    AsciiBSPrint(Buffer, sizeof(Buffer), Format, BaseListMarker);
+
+  SerialPortWrite((UINT8 *)Buffer, AsciiStrLen(Buffer));
+}
+
+VOID
+EFIAPI
+DebugPrint(IN UINTN ErrorLevel, IN CONST CHAR8 *Format, ...)
+{
+  VA_LIST Marker;
+
+  VA_START(Marker, Format);
+  DebugVPrint(ErrorLevel, Format, Marker);
+  VA_END(Marker);
+}
+
+VOID
+EFIAPI
+DebugVPrint(
+    IN UINTN ErrorLevel, IN CONST CHAR8 *Format, IN VA_LIST VaListMarker)
+{
+  DebugPrintMarker(ErrorLevel, Format, VaListMarker, NULL);
+}
+
+VOID
+EFIAPI
+DebugBPrint(
+    IN UINTN ErrorLevel, IN CONST CHAR8 *Format, IN BASE_LIST BaseListMarker)
+{
+  DebugPrintMarker(ErrorLevel, Format, mVaListNull, BaseListMarker);
+}
+
+/* Same as BaseDebugLibSerialPort, but painted even over GraphicsConsole */
+VOID
+EFIAPI
+DebugAssert(
+    IN CONST CHAR8 *FileName, IN UINTN LineNumber, IN CONST CHAR8 *Description)
+{
+  CHAR8 Buffer[MAX_DEBUG_MESSAGE_LENGTH];
+
+  AsciiSPrint(
+      Buffer, sizeof(Buffer), "ASSERT [%a] %a(%d): %a\n", gEfiCallerBaseName,
+      FileName, LineNumber, Description);
+
+  SerialPortWriteCritical((UINT8 *)Buffer, AsciiStrLen(Buffer));
+
+  if ((PcdGet8(PcdDebugPropertyMask) & DEBUG_PROPERTY_ASSERT_BREAKPOINT_ENABLED) != 0)
+    CpuBreakpoint();
+  else if ((PcdGet8(PcdDebugPropertyMask) & DEBUG_PROPERTY_ASSERT_DEADLOOP_ENABLED) != 0)
+    CpuDeadLoop();
+}
+
+VOID *
+EFIAPI
+DebugClearMemory(OUT VOID *Buffer, IN UINTN Length)
+{
+  ASSERT(Buffer != NULL);
+
+  return SetMem(Buffer, Length, PcdGet8(PcdDebugClearMemoryValue));
+}
+
+BOOLEAN
+EFIAPI
+DebugAssertEnabled(VOID)
+{
+  return (BOOLEAN)(
+      (PcdGet8(PcdDebugPropertyMask) & DEBUG_PROPERTY_DEBUG_ASSERT_ENABLED) != 0);
+}
+
+BOOLEAN
+EFIAPI
+DebugPrintEnabled(VOID)
+{
+  return (BOOLEAN)(
+      (PcdGet8(PcdDebugPropertyMask) & DEBUG_PROPERTY_DEBUG_PRINT_ENABLED) != 0);
+}
+
+BOOLEAN
+EFIAPI
+DebugCodeEnabled(VOID)
+{
+  return (BOOLEAN)(
+      (PcdGet8(PcdDebugPropertyMask) & DEBUG_PROPERTY_DEBUG_CODE_ENABLED) != 0);
+}
+
+BOOLEAN
+EFIAPI
+DebugClearMemoryEnabled(VOID)
+{
+  return (BOOLEAN)(
+      (PcdGet8(PcdDebugPropertyMask) & DEBUG_PROPERTY_CLEAR_MEMORY_ENABLED) != 0);
+}
+
+BOOLEAN
+EFIAPI
+DebugPrintLevelEnabled(IN CONST UINTN ErrorLevel)
+{
+  return (BOOLEAN)((ErrorLevel & PcdGet32(PcdFixedDebugPrintErrorLevel)) != 0);
+}
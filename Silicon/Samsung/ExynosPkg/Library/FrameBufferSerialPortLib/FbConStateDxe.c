@@ -0,0 +1,20 @@
+#include <PiDxe.h>
+
+#include <Library/HobLib.h>
+
+#include "Library/FrameBufferSerialPortLib.h"
+
+STATIC FBCON_SHARED_STATE *mSharedState = NULL;
+
+FBCON_SHARED_STATE *FbConGetSharedState(void)
+{
+  EFI_HOB_GUID_TYPE *GuidHob;
+
+  if (mSharedState == NULL) {
+    GuidHob = GetFirstGuidHob(&gExynosFbConStateHobGuid);
+    if (GuidHob != NULL)
+      mSharedState = GET_GUID_HOB_DATA(GuidHob);
+  }
+
+  return mSharedState;
+}
@@ -0,0 +1,6 @@
+#include <Base.h>
+
+#include "Library/FrameBufferSerialPortLib.h"
+
+/* SEC and runtime instance: no shared state, always paint directly */
+FBCON_SHARED_STATE *FbConGetSharedState(void) { return NULL; }
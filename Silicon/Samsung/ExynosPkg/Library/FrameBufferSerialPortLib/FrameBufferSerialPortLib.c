@@ -1,9 +1,11 @@
 #include <PiDxe.h>
 
+#include <Library/ArmGenericTimerCounterLib.h>
 #include <Library/ArmLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/CacheMaintenanceLib.h>
 #include <Library/HobLib.h>
+#include <Library/RamLogLib.h>
 #include <Library/SerialPortLib.h>
 
 #include <Resources/FbColor.h>
@@ -21,16 +23,21 @@ UINTN gWidth = FixedPcdGet32(PcdMipiFrameBufferWidth);
 UINTN gHeight = FixedPcdGet32(PcdMipiFrameBufferHeight);
 UINTN gBpp    = FixedPcdGet32(PcdMipiFrameBufferPixelBpp);
 
-// Module-used internal routine
-void FbConPutCharWithFactor(char c, int type, unsigned scale_factor);
+// Used by SEC and runtime drivers, which have no shared state
+STATIC FBCON_SHARED_STATE mLocalState;
+
+// Critical text sits between these in the RAM log, see FbConLayout()
+#define FBCON_SGR_CRITICAL "\x1b[33m"
+#define FBCON_SGR_RESET    "\x1b[0m"
 
+// Module-used internal routine
 void FbConDrawglyph(
     char *pixels, unsigned stride, unsigned bpp, unsigned *glyph,
     unsigned scale_factor);
 
 void FbConReset(void);
-void FbConScrollUp(void);
-void FbConFlush(void);
+void FbConRender(FBCON_SHARED_STATE *State, BOOLEAN Track);
+void FbConFlush(UINTN FirstRow, UINTN RowCount);
 
 RETURN_STATUS
 EFIAPI
@@ -92,76 +99,6 @@ void FbConReset(void)
   m_Color.Background = FB_BGRA8888_BLACK;
 }
 
-void FbConPutCharWithFactor(char c, int type, unsigned scale_factor)
-{
-  char *Pixels;
-
-  if (!m_Initialized)
-    return;
-
-paint:
-
-  if ((unsigned char)c > 127)
-    return;
-
-  if ((unsigned char)c < 32) {
-    if (c == '\n') {
-      goto newline;
-    }
-    else if (c == '\r') {
-      m_Position.x = 0;
-      return;
-    }
-    else {
-      return;
-    }
-  }
-
-  // Save some space
-  if (m_Position.x == 0 && (unsigned char)c == ' ' &&
-      type != FBCON_SUBTITLE_MSG && type != FBCON_TITLE_MSG)
-    return;
-
-  BOOLEAN intstate = ArmGetInterruptState();
-  ArmDisableInterrupts();
-
-  Pixels = (void *)FixedPcdGet32(PcdMipiFrameBufferAddress);
-  Pixels += m_Position.y * ((gBpp / 8) * FONT_HEIGHT * gWidth);
-  Pixels += m_Position.x * scale_factor * ((gBpp / 8) * (FONT_WIDTH + 1));
-
-  FbConDrawglyph(
-      Pixels, gWidth, (gBpp / 8), font5x12 + (c - 32) * 2, scale_factor);
-
-  m_Position.x++;
-
-  if (m_Position.x >= (int)(m_MaxPosition.x / scale_factor))
-    goto newline;
-
-  if (intstate)
-    ArmEnableInterrupts();
-  return;
-
-newline:
-  m_Position.y += scale_factor;
-  m_Position.x = 0;
-  if (m_Position.y >= m_MaxPosition.y - scale_factor) {
-    FbConFlush();
-    m_Position.y = 0;
-
-    if (intstate)
-      ArmEnableInterrupts();
-    goto paint;
-  }
-  else {
-    Pixels = (void *)FixedPcdGet32(PcdMipiFrameBufferAddress);
-    Pixels += m_Position.y * ((gBpp / 8) * FONT_HEIGHT * gWidth);
-    ZeroMem(Pixels, ((gBpp / 8) * FONT_HEIGHT * gWidth) * scale_factor);
-    FbConFlush();
-    if (intstate)
-      ArmEnableInterrupts();
-  }
-}
-
 void FbConDrawglyph(
     char *pixels, unsigned stride, unsigned bpp, unsigned *glyph,
     unsigned scale_factor)
@@ -260,53 +197,409 @@ void FbConDrawglyph(
   }
 }
 
-/* TODO: Take stride into account */
-void FbConScrollUp(void)
+STATIC UINT8 FbConTailByte(
+    CONST UINT8 *First, UINTN FirstLength, CONST UINT8 *Second, UINTN Index)
 {
-  unsigned short *dst   = (void *)FixedPcdGet32(PcdMipiFrameBufferAddress);
-  unsigned short *src   = dst + (gWidth * FONT_HEIGHT);
-  unsigned        count = gWidth * (gHeight - FONT_HEIGHT);
+  return Index < FirstLength ? First[Index] : Second[Index - FirstLength];
+}
+
+/* Pixel lines and bytes of frame buffer behind one text row */
+#define FBCON_ROW_LINES (FONT_HEIGHT * SCALE_FACTOR)
+#define FBCON_ROW_BYTES ((gBpp / 8) * FBCON_ROW_LINES * gWidth)
 
-  while (count--) {
-    *dst++ = *src++;
+/* The real frame buffer, or GOP's shadow of it once GOP has one */
+STATIC char *FbConBase(void)
+{
+  FBCON_SHARED_STATE *State = FbConGetSharedState();
+
+  if (State != NULL && State->PaintBase != 0)
+    return (char *)(UINTN)State->PaintBase;
+
+  return (char *)(UINTN)FixedPcdGet32(PcdMipiFrameBufferAddress);
+}
+
+/* Paints one text row in the background color */
+STATIC void FbConClearRow(UINTN Row)
+{
+  char *Pixels = FbConBase();
+
+  Pixels += Row * FBCON_ROW_BYTES;
+
+  if (gBpp == 32)
+    SetMem32(Pixels, FBCON_ROW_BYTES, (UINT32)m_Color.Background);
+  else
+    ZeroMem(Pixels, FBCON_ROW_BYTES);
+}
+
+/* FNV-1a over each character and its color code */
+STATIC UINT32 FbConHashSeed(void) { return 0x811C9DC5; }
+
+STATIC UINT32 FbConHashStep(UINT32 Hash, UINT8 c)
+{
+  return (Hash ^ c) * 0x01000193;
+}
+
+/* Foreground for an SGR color code, anything unknown is the default */
+STATIC UINTN FbConSgrColor(UINT8 Code)
+{
+  switch (Code) {
+  case 31:
+    return FB_BGRA8888_RED;
+  case 32:
+    return FB_BGRA8888_GREEN;
+  case 33:
+    return FB_BGRA8888_YELLOW;
+  default:
+    return FB_BGRA8888_WHITE;
   }
+}
+
+/*
+ * Lays out the ring tail from Begin with wrapping at Columns and returns
+ * the number of rows the text takes. Rows from SkipRows on are on screen:
+ * their content hash goes to Hash when given, and the ones flagged in
+ * Dirty are painted. ESC [ n m in the text sets the color of what follows.
+ */
+STATIC UINTN FbConLayout(
+    CONST UINT8 *First, UINTN FirstLength, CONST UINT8 *Second, UINTN Begin,
+    UINTN Length, UINTN Columns, UINTN Rows, UINTN SkipRows, UINT32 *Hash,
+    CONST BOOLEAN *Dirty)
+{
+  char   *Base   = FbConBase();
+  char   *Pixels;
+  UINTN   Row    = 0;
+  UINTN   Column = 0;
+  UINTN   Visible;
+  UINT8   c;
+  UINT8   Color  = 0;
+  UINT8   Code   = 0;
+  BOOLEAN Escape = FALSE;
+
+  for (UINTN Index = Begin; Index < Length; Index++) {
+    c = FbConTailByte(First, FirstLength, Second, Index);
+
+    if (c == 0x1B) {
+      Escape = TRUE;
+      Code   = 0;
+      continue;
+    }
+
+    // Only the last parameter of an SGR sequence counts, others are dropped
+    if (Escape) {
+      if (c >= '0' && c <= '9')
+        Code = Code * 10 + (c - '0');
+      else if (c == ';')
+        Code = 0;
+      else if (c != '[') {
+        Escape = FALSE;
+        if (c == 'm')
+          Color = Code;
+      }
+      continue;
+    }
+
+    if (c == '\n') {
+      Row++;
+      Column = 0;
+      continue;
+    }
+
+    if (c < 32 || c > 126)
+      continue;
+
+    if (Column == Columns) {
+      Row++;
+      Column = 0;
+    }
 
-  count = gWidth * FONT_HEIGHT;
-  while (count--) {
-    *dst++ = m_Color.Background;
+    if (Row >= SkipRows && Row - SkipRows < Rows) {
+      Visible = Row - SkipRows;
+
+      if (Hash != NULL)
+        Hash[Visible] =
+            FbConHashStep(FbConHashStep(Hash[Visible], c), Color);
+
+      if (Dirty != NULL && Dirty[Visible] && c != ' ') {
+        Pixels = Base + Visible * FBCON_ROW_BYTES;
+        Pixels += Column * SCALE_FACTOR * ((gBpp / 8) * (FONT_WIDTH + 1));
+
+        m_Color.Foreground = FbConSgrColor(Color);
+        FbConDrawglyph(
+            Pixels, gWidth, (gBpp / 8), font5x12 + (c - 32) * 2, SCALE_FACTOR);
+        m_Color.Foreground = FB_BGRA8888_WHITE;
+      }
+    }
+
+    Column++;
   }
 
-  FbConFlush();
+  return Column > 0 ? Row + 1 : Row;
 }
 
-void FbConFlush(void)
+/*
+ * Picks how many rows the text on screen has scrolled by: the shift that
+ * leaves the fewest rows to repaint, counting the block move as one row.
+ */
+STATIC UINTN FbConFindScroll(CONST UINT32 *Old, CONST UINT32 *New, UINTN Rows)
 {
-  unsigned total_x, total_y;
-  unsigned bytes_per_bpp;
+  UINTN Best     = 0;
+  UINTN BestCost = MAX_UINTN;
+  UINTN Cost;
+
+  for (UINTN Shift = 0; Shift < Rows; Shift++) {
+    Cost = Shift > 0 ? 1 + Shift : 0;
+    for (UINTN Row = 0; Row + Shift < Rows && Cost < BestCost; Row++) {
+      if (New[Row] != Old[Row + Shift])
+        Cost++;
+    }
+
+    if (Cost < BestCost) {
+      Best     = Shift;
+      BestCost = Cost;
+    }
+  }
 
-  total_x       = gWidth;
-  total_y       = gHeight;
-  bytes_per_bpp = (gBpp / 8);
+  return Best;
+}
+
+/*
+ * Shows the newest screenful of the RAM log. With Track set, State->RowHash
+ * is trusted to describe the screen: rows that are still visible are moved
+ * up as a block and only rows whose text changed are repainted.
+ */
+void FbConRender(FBCON_SHARED_STATE *State, BOOLEAN Track)
+{
+  CONST UINT8 *First;
+  CONST UINT8 *Second;
+  UINTN        FirstLength;
+  UINTN        SecondLength;
+  UINTN        Length;
+  UINTN        Begin   = 0;
+  UINTN        Columns = m_MaxPosition.x / SCALE_FACTOR;
+  UINTN        Rows    = (m_MaxPosition.y / SCALE_FACTOR) - 1;
+  UINTN        Total;
+  UINTN        Skip;
+  UINTN        Scroll = 0;
+  UINTN        FirstDirty = MAX_UINTN;
+  UINTN        LastDirty  = 0;
+  UINT32       Hash[FBCON_MAX_ROWS];
+  BOOLEAN      Dirty[FBCON_MAX_ROWS];
+  char        *Base = FbConBase();
+
+  if (Rows > FBCON_MAX_ROWS)
+    Rows = FBCON_MAX_ROWS;
+
+  Length = RamLogGetTail(
+      Rows * Columns, &First, &FirstLength, &Second, &SecondLength);
+
+  // A full window most likely starts mid-line, begin at the next one
+  if (Length == Rows * Columns) {
+    while (Begin < Length &&
+           FbConTailByte(First, FirstLength, Second, Begin) != '\n')
+      Begin++;
+    Begin = Begin < Length ? Begin + 1 : 0;
+  }
+
+  Total = FbConLayout(
+      First, FirstLength, Second, Begin, Length, Columns, Rows, 0, NULL, NULL);
+  Skip = Total > Rows ? Total - Rows : 0;
+
+  for (UINTN Row = 0; Row < Rows; Row++)
+    Hash[Row] = FbConHashSeed();
+  FbConLayout(
+      First, FirstLength, Second, Begin, Length, Columns, Rows, Skip, Hash,
+      NULL);
+
+  Track = Track && State->RowsValid;
+  if (Track) {
+    Scroll = FbConFindScroll(State->RowHash, Hash, Rows);
+    if (Scroll > 0) {
+      CopyMem(
+          Base, Base + Scroll * FBCON_ROW_BYTES, (Rows - Scroll) * FBCON_ROW_BYTES);
+      CopyMem(
+          State->RowHash, State->RowHash + Scroll,
+          (Rows - Scroll) * sizeof(UINT32));
+    }
+  }
+
+  for (UINTN Row = 0; Row < Rows; Row++) {
+    Dirty[Row] =
+        !Track || Row + Scroll >= Rows || Hash[Row] != State->RowHash[Row];
+    if (Dirty[Row]) {
+      FbConClearRow(Row);
+      FirstDirty = MIN(FirstDirty, Row);
+      LastDirty  = Row;
+    }
+  }
+
+  FbConLayout(
+      First, FirstLength, Second, Begin, Length, Columns, Rows, Skip, NULL,
+      Dirty);
+
+  CopyMem(State->RowHash, Hash, Rows * sizeof(UINT32));
+  State->RowsValid = TRUE;
+
+  // A scroll moved every row, otherwise only the repainted span changed
+  if (Scroll > 0)
+    FbConFlush(0, Rows);
+  else if (FirstDirty != MAX_UINTN)
+    FbConFlush(FirstDirty, LastDirty - FirstDirty + 1);
+}
+
+/*
+ * Refreshes the screen at most once per PcdFrameBufferConsoleRenderInterval
+ * milliseconds. Output in between is marked pending: the next write after
+ * the interval or FbConFlushPending() picks it up. Interrupts stay enabled
+ * while painting, a write from an interrupt handler that lands in the
+ * middle of a refresh is deferred the same way.
+ */
+STATIC void FbConRenderLazy(BOOLEAN Force)
+{
+  FBCON_SHARED_STATE *Shared = FbConGetSharedState();
+  FBCON_SHARED_STATE *State  = Shared != NULL ? Shared : &mLocalState;
+  UINT64              Frequency;
+  UINT64              Now;
+  UINT64              Interval;
+
+  if (!m_Initialized)
+    return;
+
+  // Platforms that leave the PCD at 0 rely on CNTFRQ, as ArmArchTimerLib
+  Frequency = FixedPcdGet32(PcdArmArchTimerFreqInHz);
+  if (Frequency == 0)
+    Frequency = ArmGenericTimerGetTimerFreq();
+
+  Now      = ArmGenericTimerGetSystemCount();
+  Interval = Frequency / 1000 *
+             FixedPcdGet32(PcdFrameBufferConsoleRenderInterval);
+
+  // The refresh that is running picks forced text up before it returns
+  if (State->Rendering) {
+    State->RenderPending = TRUE;
+    if (Force)
+      State->RenderAgain = TRUE;
+    return;
+  }
+
+  if (!Force && State->LastRender != 0 && Now - State->LastRender < Interval) {
+    State->RenderPending = TRUE;
+    return;
+  }
+
+  State->Rendering = TRUE;
+
+  // Only the shared state sees every painter, and only until GOP exists
+  do {
+    State->RenderPending = FALSE;
+    State->RenderAgain   = FALSE;
+    FbConRender(State, Shared != NULL && !Shared->GopInstalled);
+  } while (State->RenderAgain);
+
+  State->LastRender = Now;
+  State->Rendering  = FALSE;
+}
+
+void FbConFlush(UINTN FirstRow, UINTN RowCount)
+{
+  FBCON_SHARED_STATE *State = FbConGetSharedState();
+
+  // The shadow is cacheable, GOP copies the rows out on its next flush
+  if (State != NULL && State->PaintBase != 0) {
+    State->DirtyFirst = State->DirtyEnd == 0
+                            ? (UINT32)FirstRow
+                            : MIN(State->DirtyFirst, (UINT32)FirstRow);
+    State->DirtyEnd = MAX(State->DirtyEnd, (UINT32)(FirstRow + RowCount));
+    return;
+  }
 
   WriteBackInvalidateDataCacheRange(
-      (void *)FixedPcdGet32(PcdMipiFrameBufferAddress),
-      (total_x * total_y * bytes_per_bpp));
+      FbConBase() + FirstRow * FBCON_ROW_BYTES, RowCount * FBCON_ROW_BYTES);
+}
+
+VOID EFIAPI FbConHandOffToGop(VOID)
+{
+  FBCON_SHARED_STATE *State = FbConGetSharedState();
+
+  if (State == NULL)
+    return;
+
+  // GOP clears the screen and may draw over us from now on
+  State->GopInstalled = TRUE;
+  State->RowsValid    = FALSE;
+
+  if (FixedPcdGet8(PcdFrameBufferConsoleRenderer) ==
+      FBCON_RENDERER_GRAPHICS_CONSOLE)
+    State->GopActive = TRUE;
+}
+
+/*
+ * Copies the rows painted into GOP's shadow to the screen right away, for
+ * text that cannot wait for the next shadow flush.
+ */
+STATIC void FbConPushShadow(FBCON_SHARED_STATE *State)
+{
+  char *Screen = (char *)(UINTN)FixedPcdGet32(PcdMipiFrameBufferAddress);
+  UINTN Offset;
+  UINTN Size;
+
+  if (State == NULL || State->PaintBase == 0 || State->DirtyEnd == 0)
+    return;
+
+  Offset = State->DirtyFirst * FBCON_ROW_BYTES;
+  Size   = (State->DirtyEnd - State->DirtyFirst) * FBCON_ROW_BYTES;
+  CopyMem(Screen + Offset, (char *)(UINTN)State->PaintBase + Offset, Size);
+  WriteBackInvalidateDataCacheRange(Screen + Offset, Size);
+}
+
+VOID EFIAPI FbConSetPaintTarget(IN VOID *FrameBuffer)
+{
+  FBCON_SHARED_STATE *State = FbConGetSharedState();
+
+  if (State == NULL)
+    return;
+
+  State->PaintBase = (UINTN)FrameBuffer;
+  State->DirtyEnd  = 0;
+  State->RowsValid = FALSE;
+}
+
+UINTN EFIAPI FbConTakeDirtyLines(OUT UINTN *FirstLine)
+{
+  FBCON_SHARED_STATE *State = FbConGetSharedState();
+  UINTN               Lines;
+
+  if (State == NULL || State->DirtyEnd == 0)
+    return 0;
+
+  *FirstLine      = State->DirtyFirst * FBCON_ROW_LINES;
+  Lines           = (State->DirtyEnd - State->DirtyFirst) * FBCON_ROW_LINES;
+  State->DirtyEnd = 0;
+  return Lines;
+}
+
+VOID EFIAPI FbConFlushPending(VOID)
+{
+  FBCON_SHARED_STATE *State = FbConGetSharedState();
+
+  if (State == NULL || State->GopActive || !State->RenderPending)
+    return;
+
+  FbConRenderLazy(FALSE);
 }
 
 UINTN
 EFIAPI
 SerialPortWrite(IN UINT8 *Buffer, IN UINTN NumberOfBytes)
 {
-  UINT8 *CONST Final          = &Buffer[NumberOfBytes];
-  UINTN        InterruptState = ArmGetInterruptState();
-  ArmDisableInterrupts();
+  FBCON_SHARED_STATE *State = FbConGetSharedState();
 
-  while (Buffer < Final) {
-    FbConPutCharWithFactor(*Buffer++, FBCON_COMMON_MSG, SCALE_FACTOR);
-  }
+  RamLogWrite(Buffer, NumberOfBytes);
 
-  if (InterruptState)
-    ArmEnableInterrupts();
+  // GraphicsConsole owns the screen, only keep the text in memory
+  if (State != NULL && State->GopActive)
+    return NumberOfBytes;
+
+  FbConRenderLazy(FALSE);
   return NumberOfBytes;
 }
 
@@ -314,21 +607,16 @@ UINTN
 EFIAPI
 SerialPortWriteCritical(IN UINT8 *Buffer, IN UINTN NumberOfBytes)
 {
-  UINT8 *CONST Final             = &Buffer[NumberOfBytes];
-  UINTN        CurrentForeground = m_Color.Foreground;
-  UINTN        InterruptState    = ArmGetInterruptState();
+  // The color goes into the RAM log, so it sticks to these lines only
+  RamLogWrite((UINT8 *)FBCON_SGR_CRITICAL, sizeof(FBCON_SGR_CRITICAL) - 1);
+  RamLogWrite(Buffer, NumberOfBytes);
+  RamLogWrite((UINT8 *)FBCON_SGR_RESET, sizeof(FBCON_SGR_RESET) - 1);
 
-  ArmDisableInterrupts();
-  m_Color.Foreground = FB_BGRA8888_YELLOW;
+  // Show it now whoever owns the screen, the system may not get far enough
+  // for a shadow flush
+  FbConRenderLazy(TRUE);
+  FbConPushShadow(FbConGetSharedState());
 
-  while (Buffer < Final) {
-    FbConPutCharWithFactor(*Buffer++, FBCON_COMMON_MSG, SCALE_FACTOR);
-  }
-
-  m_Color.Foreground = CurrentForeground;
-
-  if (InterruptState)
-    ArmEnableInterrupts();
   return NumberOfBytes;
 }
 
@@ -358,7 +646,15 @@ SerialPortSetAttributes(
   return RETURN_UNSUPPORTED;
 }
 
-UINTN SerialPortFlush(VOID) { return 0; }
+UINTN SerialPortFlush(VOID)
+{
+  FBCON_SHARED_STATE *State = FbConGetSharedState();
+
+  if (State == NULL || !State->GopActive)
+    FbConRenderLazy(TRUE);
+
+  return 0;
+}
 
 VOID EnableSynchronousSerialPortIO(VOID)
 {
@@ -0,0 +1,130 @@
+#include <PiPei.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryMapHelperLib.h>
+#include <Library/PcdLib.h>
+#include <Library/RamLogLib.h>
+
+STATIC RAM_LOG_BUFFER *mRamLog         = NULL;
+STATIC UINT32          mRamLogCapacity = 0;
+
+STATIC RAM_LOG_BUFFER *RamLogLocate(VOID)
+{
+  EFI_PHYSICAL_ADDRESS Base;
+  UINTN                Size;
+  UINTN                ConsoleSize;
+
+  if (mRamLog == NULL && RamLogGetRegion(&Base, &Size, &ConsoleSize)) {
+    mRamLog         = (RAM_LOG_BUFFER *)(UINTN)(Base + Size - ConsoleSize);
+    mRamLogCapacity = (UINT32)(ConsoleSize - sizeof(RAM_LOG_BUFFER));
+  }
+
+  return mRamLog;
+}
+
+BOOLEAN EFIAPI RamLogGetRegion(
+    OUT EFI_PHYSICAL_ADDRESS *Base, OUT UINTN *Size, OUT UINTN *ConsoleSize)
+{
+  ARM_MEMORY_REGION_DESCRIPTOR_EX Region;
+  UINTN                           Console = FixedPcdGet32(PcdRamLogConsoleSize);
+
+  if (LocateMemoryMapAreaByName(RAM_LOG_REGION_NAME, &Region) != EFI_SUCCESS)
+    return FALSE;
+
+  if (Console <= sizeof(RAM_LOG_BUFFER) || Console > Region.Length)
+    return FALSE;
+
+  *Base        = Region.Address;
+  *Size        = (UINTN)Region.Length;
+  *ConsoleSize = Console;
+  return TRUE;
+}
+
+RETURN_STATUS
+EFIAPI
+RamLogInitialize(VOID)
+{
+  RAM_LOG_BUFFER *Ring = RamLogLocate();
+
+  if (Ring == NULL)
+    return RETURN_NOT_FOUND;
+
+  // Same checks the kernel applies before it trusts an old buffer
+  if (Ring->Signature != RAM_LOG_SIGNATURE || Ring->Size > mRamLogCapacity ||
+      Ring->Start > Ring->Size) {
+    Ring->Signature = RAM_LOG_SIGNATURE;
+    Ring->Start     = 0;
+    Ring->Size      = 0;
+  }
+
+  // Keep whatever the previous boot left, a hang is what we are after
+  if (Ring->Size != 0)
+    RamLogWrite((CONST UINT8 *)"\n", 1);
+
+  return RETURN_SUCCESS;
+}
+
+VOID EFIAPI RamLogWrite(IN CONST UINT8 *Buffer, IN UINTN NumberOfBytes)
+{
+  RAM_LOG_BUFFER *Ring = RamLogLocate();
+  BOOLEAN         InterruptState;
+  UINTN           Start;
+  UINTN           First;
+
+  if (Ring == NULL || Ring->Signature != RAM_LOG_SIGNATURE ||
+      NumberOfBytes == 0)
+    return;
+
+  // Only the newest mRamLogCapacity bytes would survive anyway
+  if (NumberOfBytes > mRamLogCapacity) {
+    Buffer += NumberOfBytes - mRamLogCapacity;
+    NumberOfBytes = mRamLogCapacity;
+  }
+
+  /*
+   * Reserve the range, then fill it with interrupts enabled. A writer that
+   * interrupts us gets the range after ours, so neither waits on the other.
+   */
+  InterruptState = SaveAndDisableInterrupts();
+  Start          = Ring->Start;
+  Ring->Start    = (UINT32)((Start + NumberOfBytes) % mRamLogCapacity);
+  Ring->Size     = (UINT32)MIN(Ring->Size + NumberOfBytes, mRamLogCapacity);
+  SetInterruptState(InterruptState);
+
+  First = MIN(NumberOfBytes, mRamLogCapacity - Start);
+  CopyMem(&Ring->Data[Start], Buffer, First);
+  CopyMem(Ring->Data, Buffer + First, NumberOfBytes - First);
+}
+
+UINTN EFIAPI RamLogGetTail(
+    IN UINTN MaxBytes, OUT CONST UINT8 **First, OUT UINTN *FirstLength,
+    OUT CONST UINT8 **Second, OUT UINTN *SecondLength)
+{
+  RAM_LOG_BUFFER *Ring = RamLogLocate();
+  UINTN           Length;
+  UINTN           Begin;
+
+  *First        = NULL;
+  *FirstLength  = 0;
+  *Second       = NULL;
+  *SecondLength = 0;
+
+  if (Ring == NULL || Ring->Signature != RAM_LOG_SIGNATURE)
+    return 0;
+
+  Length = MIN(Ring->Size, MaxBytes);
+  Begin  = (Ring->Start + mRamLogCapacity - Length) % mRamLogCapacity;
+
+  *First = &Ring->Data[Begin];
+  if (Begin + Length <= mRamLogCapacity) {
+    *FirstLength = Length;
+  }
+  else {
+    *FirstLength  = mRamLogCapacity - Begin;
+    *Second       = Ring->Data;
+    *SecondLength = Length - *FirstLength;
+  }
+
+  return Length;
+}
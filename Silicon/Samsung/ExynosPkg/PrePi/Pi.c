@@ -8,6 +8,10 @@
 #include <Library/PrePiHobListPointerLib.h>
 #include <Library/CacheMaintenanceLib.h>
 #include <Library/PlatformPrePiLib.h>
+#include <Library/HobLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/FrameBufferSerialPortLib.h>
+#include <Library/RamLogLib.h>
 
 #include <Ppi/GuidedSectionExtraction.h>
 
@@ -30,6 +34,7 @@ PrePiMain(
 
   EFI_HOB_HANDOFF_INFO_TABLE *HobList;
   EFI_STATUS                  Status;
+  FBCON_SHARED_STATE         *FbConState;
 
   UINTN MemoryBase     = 0;
   UINTN MemorySize     = 0;
@@ -89,6 +94,12 @@ PrePiMain(
   // TODO: Call CpuPei as a library
   BuildCpuHob (ArmGetPhysicalAddressBits (), PcdGet8 (PcdPrePiCpuIoSize));
 
+  // Console state shared by the DXE phase FrameBufferSerialPortLib copies
+  FbConState = BuildGuidHob (&gExynosFbConStateHobGuid, sizeof (FBCON_SHARED_STATE));
+  if (FbConState != NULL) {
+    ZeroMem (FbConState, sizeof (FBCON_SHARED_STATE));
+  }
+
   // Set the Boot Mode
   SetBootMode (BOOT_WITH_DEFAULT_SETTINGS);
 
@@ -120,6 +131,9 @@ CEntryPoint(
   IN UINTN StackSize
   )
 {
+  // Pick up the log ring first so even the earliest DEBUG output is kept
+  RamLogInitialize();
+
   // Do platform specific initialization here
   PlatformInitialize();
 
@@ -0,0 +1,87 @@
+#!/bin/bash
+# Boot-to-shell timing for the virt target. Each run boots the BootShim
+# image with a UFS-like disk set whose startup.nsh powers the VM off, so
+# the wall time of one QEMU process is firmware entry to Shell plus QEMU
+# start-up. The disk set is built once and shared by all runs, so the
+# first run boots with an empty uefivars partition and the ones after it
+# find the variables it left behind. The first run is reported as the
+# cold boot and the statistics cover the warm runs that follow.
+
+function _help(){
+	echo "Usage: bench.sh [-k KERNEL] [-n RUNS] [-t TIMEOUT]"
+	echo
+	echo "	-k KERNEL:  BootShim image, default uefi-virt-kernel."
+	echo "	-n RUNS:    number of boots, default 10."
+	echo "	-t TIMEOUT: seconds before a boot counts as hung, default 60."
+	exit "${1}"
+}
+
+function _error(){ echo "${@}" >&2;exit 1; }
+
+function _now_ms(){ echo "$(($(date +%s%N) / 1000000))"; }
+
+KERNEL="uefi-virt-kernel"
+RUNS=10
+TIMEOUT=60
+QEMU="${QEMU:-qemu-system-aarch64}"
+
+while getopts "k:n:t:h" OPT
+do
+	case "${OPT}" in
+		k) KERNEL="${OPTARG}";;
+		n) RUNS="${OPTARG}";;
+		t) TIMEOUT="${OPTARG}";;
+		h) _help 0;;
+		*) _help 1;;
+	esac
+done
+
+[ -f "${KERNEL}" ]||_error "${KERNEL} not found, build with ./build.sh -d virt"
+command -v "${QEMU}" >/dev/null||_error "${QEMU} not found"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "${WORK}"' EXIT
+
+echo "reset -s" > "${WORK}/startup.nsh"
+bash "$(dirname "$0")/mkdisk.sh" "${WORK}/disk" "${WORK}/startup.nsh"||exit "$?"
+
+# EL2 entry with PSCI over SMC, the same conduit the phones use
+QEMU_ARGS=(
+	-M virt,virtualization=on,gic-version=2
+	-cpu cortex-a57 -smp 4 -m 2048
+	-kernel "${KERNEL}"
+	-device ramfb -display none
+	-serial none -monitor none
+	-no-reboot
+)
+for LUN in 0 1 2 3
+do
+	QEMU_ARGS+=(
+		-drive "if=none,format=raw,file=${WORK}/disk/lu${LUN}.img,id=lu${LUN}"
+		-device "virtio-blk-device,drive=lu${LUN}"
+	)
+done
+
+: > "${WORK}/times"
+for RUN in $(seq 1 "${RUNS}")
+do
+	START="$(_now_ms)"
+	timeout "${TIMEOUT}" "${QEMU}" "${QEMU_ARGS[@]}"
+	STATUS="$?"
+	END="$(_now_ms)"
+	[ "${STATUS}" == 0 ]||_error "run ${RUN}: qemu exited with ${STATUS}"
+	echo "run ${RUN}: $((END - START)) ms"
+	if [ "${RUN}" == 1 ]
+	then echo "$((END - START))" > "${WORK}/cold"
+	else echo "$((END - START))" >> "${WORK}/times"
+	fi
+done
+
+echo "cold: $(cat "${WORK}/cold") ms"
+sort -n "${WORK}/times"|awk '
+	{ t[NR] = $1; sum += $1 }
+	END {
+		if (NR == 0) exit
+		printf "warm runs %d, min %d ms, median %d ms, mean %d ms, max %d ms\n",
+			NR, t[1], t[int((NR + 1) / 2)], sum / NR, t[NR]
+	}'
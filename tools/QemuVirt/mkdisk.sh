@@ -0,0 +1,67 @@
+#!/bin/bash
+# Builds one raw GPT image per UFS logical unit, laid out like the Exynos
+# phones: LU0 carries the big partition table, LU1/LU2 are the boot LUs and
+# LU3 holds the small persistent partitions. Each image becomes one
+# virtio-blk device. Needs sgdisk and mtools, no root.
+
+function _error(){ echo "${@}" >&2;exit 1; }
+
+function _mkpart(){
+	local IMG="${1}" NAME="${2}" SIZE="${3}" TYPE="${4:-8300}"
+	sgdisk -q -n "0:0:${SIZE}" -t "0:${TYPE}" -c "0:${NAME}" "${IMG}" \
+		||_error "sgdisk failed on ${IMG}"
+}
+
+function _mklun(){
+	local IMG="${1}" SIZE="${2}"
+	rm -f "${IMG}"
+	truncate -s "${SIZE}" "${IMG}"
+	sgdisk -q -o "${IMG}"||_error "sgdisk failed on ${IMG}"
+}
+
+OUT="${1:-qemu-disk}"
+STARTUP="${2}"
+
+command -v sgdisk >/dev/null||_error "sgdisk not found"
+command -v mformat >/dev/null||_error "mtools not found"
+mkdir -p "${OUT}"
+
+_mklun "${OUT}/lu0.img" 1G
+_mkpart "${OUT}/lu0.img" efs +20M
+_mkpart "${OUT}/lu0.img" sec_efs +20M
+_mkpart "${OUT}/lu0.img" param +8M
+_mkpart "${OUT}/lu0.img" up_param +8M
+_mkpart "${OUT}/lu0.img" boot_a +64M
+_mkpart "${OUT}/lu0.img" boot_b +64M
+_mkpart "${OUT}/lu0.img" dtbo_a +8M
+_mkpart "${OUT}/lu0.img" dtbo_b +8M
+_mkpart "${OUT}/lu0.img" vbmeta_a +1M
+_mkpart "${OUT}/lu0.img" vbmeta_b +1M
+_mkpart "${OUT}/lu0.img" esp +64M EF00
+_mkpart "${OUT}/lu0.img" uefivars +1M
+_mkpart "${OUT}/lu0.img" super +256M
+_mkpart "${OUT}/lu0.img" userdata 0
+
+_mklun "${OUT}/lu1.img" 8M
+_mkpart "${OUT}/lu1.img" bota0 0
+
+_mklun "${OUT}/lu2.img" 8M
+_mkpart "${OUT}/lu2.img" bota1 0
+
+_mklun "${OUT}/lu3.img" 16M
+_mkpart "${OUT}/lu3.img" persist +8M
+_mkpart "${OUT}/lu3.img" keydata +1M
+_mkpart "${OUT}/lu3.img" keyrefuge 0
+
+# FAT32 ESP, optionally with a startup.nsh for the Shell to run
+ESP_START="$(sgdisk -i 11 "${OUT}/lu0.img"|sed -n 's/^First sector: \([0-9]*\).*/\1/p')"
+[ -n "${ESP_START}" ]||_error "esp not found"
+rm -f "${OUT}/esp.img"
+truncate -s 64M "${OUT}/esp.img"
+mformat -i "${OUT}/esp.img" -F -v ESP ::||_error "mformat failed"
+if [ -n "${STARTUP}" ]
+then mcopy -i "${OUT}/esp.img" "${STARTUP}" ::/startup.nsh||_error "mcopy failed"
+fi
+dd if="${OUT}/esp.img" of="${OUT}/lu0.img" bs=512 seek="${ESP_START}" conv=notrunc status=none \
+	||_error "dd failed"
+rm -f "${OUT}/esp.img"